@@ -0,0 +1,101 @@
+#include "AsyncIO.h"
+
+#include <chrono>
+
+static uint64_t Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+AsyncTraceSource::AsyncTraceSource(TraceSource *source, size_t ring_size)
+    :   m_source(source),
+        m_ring(ring_size),
+        m_finished(false),
+        m_stop(false),
+        m_progress(source->Progress()),
+        m_done(false) {
+    m_reader = std::thread(&AsyncTraceSource::Read, this);
+}
+
+AsyncTraceSource::~AsyncTraceSource() {
+    m_stop.store(true, std::memory_order_relaxed);
+    m_reader.join();
+    delete m_source;
+}
+
+void AsyncTraceSource::Read() {
+    TraceRecord record;
+    for (uint64_t count = 1; m_source->Next(record); count++) {
+        if (count % ASYNC_PROGRESS_INTERVAL == 0) m_progress.store(m_source->Progress(), std::memory_order_relaxed);
+        while (!m_ring.push(record)) {
+            if (m_stop.load(std::memory_order_relaxed)) return;
+            std::this_thread::yield();
+        }
+    }
+    m_progress.store(m_source->Progress(), std::memory_order_relaxed);
+    m_finished.store(true, std::memory_order_release);
+}
+
+bool AsyncTraceSource::Next(TraceRecord &record) {
+    if (m_done) return false;
+    if (m_ring.pop(record)) return true;
+    auto start = Now();
+    m_wait.stalls++;
+    while (true) {
+        // check finished before popping so a record pushed just before the flag is never missed
+        bool finished = m_finished.load(std::memory_order_acquire);
+        if (m_ring.pop(record)) break;
+        if (finished) {
+            m_wait.nanoseconds += Now() - start;
+            m_done = true;
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    m_wait.nanoseconds += Now() - start;
+    return true;
+}
+
+
+TimingWriter::TimingWriter(FILE *out, size_t ring_size)
+    :   m_out(out),
+        m_ring(ring_size),
+        m_finished(false) {
+    m_writer = std::thread(&TimingWriter::Write, this);
+}
+
+TimingWriter::~TimingWriter() {
+    Finish();
+}
+
+void TimingWriter::Write() {
+    TimingRecord record;
+    while (true) {
+        bool finished = m_finished.load(std::memory_order_acquire);
+        if (m_ring.pop(record)) {
+            record.Print(m_out);
+        } else if (finished) {
+            break;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    fflush(m_out);
+}
+
+void TimingWriter::Push(const TimingRecord &record) {
+    if (m_ring.push(record)) return;
+    auto start = Now();
+    m_wait.stalls++;
+    while (!m_ring.push(record)) {
+        std::this_thread::yield();
+    }
+    m_wait.nanoseconds += Now() - start;
+}
+
+void TimingWriter::Finish() {
+    if (!m_writer.joinable()) return;
+    m_finished.store(true, std::memory_order_release);
+    m_writer.join();
+}
@@ -0,0 +1,72 @@
+#ifndef ECE463_PROJ3_ASYNCIO_H
+#define ECE463_PROJ3_ASYNCIO_H
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+
+#include "Simulator.h"
+#include "SpscRing.h"
+#include "Trace.h"
+
+#define ASYNC_RING_SIZE 4096
+#define ASYNC_PROGRESS_INTERVAL 4096 // records between progress updates from the reader thread
+
+// Time and number of times the simulation thread blocked on a ring
+struct RingWait {
+    uint64_t stalls = 0;
+    uint64_t nanoseconds = 0;
+
+    void Print(const char *name, FILE *out = stderr) const {
+        fprintf(out, "%s: core waited %.3f ms over %llu stalls\n",
+            name, nanoseconds / 1e6, (unsigned long long)stalls);
+    }
+};
+
+// Parses the wrapped source on a reader thread, Fetch() consumes from the ring
+class AsyncTraceSource : public TraceSource {
+    TraceSource *m_source;
+    SpscRing<TraceRecord> m_ring;
+    std::atomic<bool> m_finished;
+    std::atomic<bool> m_stop;
+    std::atomic<double> m_progress;
+    std::thread m_reader;
+    RingWait m_wait;
+    bool m_done; // a Next() found the ring empty after the reader finished, only touched by the consumer
+
+    void Read();
+public:
+    // Takes ownership of source
+    explicit AsyncTraceSource(TraceSource *source, size_t ring_size = ASYNC_RING_SIZE);
+    ~AsyncTraceSource() override;
+
+    bool Next(TraceRecord &record) override;
+    [[nodiscard]] bool Done() const override {return m_done;}
+    // Progress of the reader thread, at most a ring ahead of Fetch()
+    [[nodiscard]] double Progress() const override {return m_progress.load(std::memory_order_relaxed);}
+
+    [[nodiscard]] const RingWait &Wait() const {return m_wait;}
+};
+
+// Formats retired timing records on a writer thread, in the order they were pushed
+class TimingWriter {
+    FILE *m_out;
+    SpscRing<TimingRecord> m_ring;
+    std::atomic<bool> m_finished;
+    std::thread m_writer;
+    RingWait m_wait;
+
+    void Write();
+public:
+    explicit TimingWriter(FILE *out = stdout, size_t ring_size = ASYNC_RING_SIZE);
+    ~TimingWriter();
+
+    void Push(const TimingRecord &record);
+
+    // Drains the ring and joins the writer thread
+    void Finish();
+
+    [[nodiscard]] const RingWait &Wait() const {return m_wait;}
+};
+
+#endif //ECE463_PROJ3_ASYNCIO_H
@@ -0,0 +1,77 @@
+#include "Heartbeat.h"
+
+#include "Simulator.h"
+
+volatile sig_atomic_t Heartbeat::s_snapshot_requested = 0;
+
+void Heartbeat::OnSignal(int) {
+    s_snapshot_requested = 1;
+}
+
+bool Heartbeat::InstallSignalHandler() {
+    struct sigaction action = {};
+    action.sa_handler = OnSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART; // a signal during an fscanf() or fwrite() must not fail the I/O
+    return sigaction(SIGUSR1, &action, nullptr) == 0;
+}
+
+Heartbeat::Heartbeat(double interval_seconds, uint64_t interval_instructions, FILE *out)
+    :   m_out(out),
+        m_interval_seconds(interval_seconds),
+        m_interval_instructions(interval_instructions),
+        m_start(Clock::now()),
+        m_next_instructions(interval_instructions ? interval_instructions : UINT64_MAX) {
+    m_next_time = m_interval_seconds > 0
+        ? m_start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(m_interval_seconds))
+        : Clock::time_point::max();
+}
+
+void Heartbeat::Poll(const Simulator &simulator) {
+    if (s_snapshot_requested) {
+        s_snapshot_requested = 0;
+        Report(simulator, true);
+    }
+    bool due = false;
+    if (simulator.GetRetiredCount() >= m_next_instructions) {
+        while (m_next_instructions <= simulator.GetRetiredCount()) m_next_instructions += m_interval_instructions;
+        due = true;
+    }
+    if (m_next_time != Clock::time_point::max()) {
+        auto now = Clock::now();
+        if (now >= m_next_time) {
+            auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(m_interval_seconds));
+            while (m_next_time <= now) m_next_time += interval;
+            due = true;
+        }
+    }
+    if (due) Report(simulator);
+}
+
+void Heartbeat::Report(const Simulator &simulator, bool snapshot) {
+    double elapsed = std::chrono::duration<double>(Clock::now() - m_start).count();
+    uint64_t retired = simulator.GetRetiredCount(), cycles = simulator.GetCycleCount();
+    double ipc = cycles ? static_cast<double>(retired) / cycles : 0.0;
+    double mips = elapsed > 0 ? retired / elapsed / 1e6 : 0.0;
+    fprintf(m_out, "[%s] %.1f s: retired %llu, cycle %llu, IPC %.2f, %.2f MIPS",
+        snapshot ? "snapshot" : "heartbeat", elapsed, (unsigned long long)retired, (unsigned long long)cycles, ipc, mips);
+
+    double progress = simulator.GetTraceProgress();
+    if (progress >= 0) {
+        fprintf(m_out, ", %.1f%% of trace", progress * 100);
+        if (progress > 0) {
+            auto eta = static_cast<uint64_t>(elapsed * (1 - progress) / progress);
+            fprintf(m_out, ", ETA %02llu:%02llu:%02llu", (unsigned long long)(eta / 3600),
+                (unsigned long long)(eta / 60 % 60), (unsigned long long)(eta % 60));
+        }
+    }
+    fprintf(m_out, "\n");
+
+    if (snapshot) {
+        auto config = simulator.GetConfig();
+        fprintf(m_out, "[snapshot] fetched %llu, ROB %zu/%d, IQ %zu/%d, WIDTH %d\n",
+            (unsigned long long)simulator.GetFetchedCount(), simulator.GetROBOccupancy(), config.rob_size,
+            simulator.GetIQOccupancy(), config.iq_size, config.width);
+    }
+    fflush(m_out);
+}
@@ -0,0 +1,39 @@
+#ifndef ECE463_PROJ3_HEARTBEAT_H
+#define ECE463_PROJ3_HEARTBEAT_H
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+
+#define HEARTBEAT_POLL_CYCLES 65536 // cycles between Poll() calls from the simulator, bounds SIGUSR1 latency too
+
+class Simulator;
+
+// Periodic progress lines for long runs: retired instructions, cycle, IPC, simulated MIPS, trace progress and ETA.
+// SIGUSR1 asks for an immediate snapshot that also shows ROB and IQ occupancy.
+// The simulator only compares its cycle count against a threshold every cycle and calls Poll() every
+// HEARTBEAT_POLL_CYCLES cycles, which is where the clock is read.
+class Heartbeat {
+    typedef std::chrono::steady_clock Clock;
+
+    FILE *m_out;
+    double m_interval_seconds;       // 0 disables timed reports
+    uint64_t m_interval_instructions; // 0 disables instruction-count reports
+    Clock::time_point m_start, m_next_time;
+    uint64_t m_next_instructions;
+
+    static volatile sig_atomic_t s_snapshot_requested;
+    static void OnSignal(int);
+public:
+    explicit Heartbeat(double interval_seconds, uint64_t interval_instructions = 0, FILE *out = stderr);
+
+    // Routes SIGUSR1 to Snapshot() at the next Poll(), returns false if the handler could not be installed
+    static bool InstallSignalHandler();
+
+    void Poll(const Simulator &simulator);
+
+    // One progress line, and the occupancy line as well when snapshot is set
+    void Report(const Simulator &simulator, bool snapshot = false);
+};
+
+#endif //ECE463_PROJ3_HEARTBEAT_H
@@ -0,0 +1,20 @@
+#include "Instrumentation.h"
+
+const char *const pipeline_stage_str[STAGE_COUNT] = {"FE", "DE", "RN", "RR", "DI", "IS", "EX", "WB", "RT"};
+
+void CounterInstrumentation::End(Simulator &simulator) {
+    uint64_t cycles = simulator.GetCycleCount();
+    fprintf(out, "# instructions entering each stage over %llu cycles\n", (unsigned long long)cycles);
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        fprintf(out, "%s %12llu %8.3f/cycle\n", pipeline_stage_str[s], (unsigned long long)entered[s],
+            cycles ? static_cast<double>(entered[s]) / cycles : 0.0);
+    }
+    fprintf(out, "CM %12llu %8.3f/cycle\n", (unsigned long long)retired,
+        cycles ? static_cast<double>(retired) / cycles : 0.0);
+}
+
+void CycleDumpInstrumentation::Stage(PipelineStage stage) {
+    static const char *const stage_name[STAGE_COUNT] = {
+        "Fetch", "Decode", "Rename", "RegRead", "Dispatch", "Issue", "Execute", "Writeback", "Retire"};
+    fprintf(out, "%s\n", stage_name[stage]);
+}
@@ -0,0 +1,84 @@
+// Instrumentation policies for Simulator::Run() and Step().
+// The core is instantiated once per policy, so hooks a policy leaves empty compile away entirely:
+// NoInstrumentation generates the same cycle loop as a build without any debug output.
+
+#ifndef ECE463_PROJ3_INSTRUMENTATION_H
+#define ECE463_PROJ3_INSTRUMENTATION_H
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "Simulator.h"
+
+enum PipelineStage {STAGE_FE, STAGE_DE, STAGE_RN, STAGE_RR, STAGE_DI, STAGE_IS, STAGE_EX, STAGE_WB, STAGE_RT, STAGE_COUNT};
+
+extern const char *const pipeline_stage_str[STAGE_COUNT];
+
+// Forced even at -O0, the default build, so empty hooks never cost a call
+#define INSTRUMENTATION_HOOK __attribute__((always_inline)) inline
+
+// Every hook a policy can implement. Policies derive from this and hide the hooks they use.
+struct NoInstrumentation {
+    // Around Run(), Step() leaves these to the caller
+    INSTRUMENTATION_HOOK void Begin(Simulator &) {}
+    INSTRUMENTATION_HOOK void End(Simulator &) {}
+    // Start of every cycle, before any stage runs
+    INSTRUMENTATION_HOOK void Cycle(Simulator &) {}
+    // A stage function is about to run
+    INSTRUMENTATION_HOOK void Stage(PipelineStage) {}
+    // instr moved into stage this cycle
+    INSTRUMENTATION_HOOK void Enter(PipelineStage, const Instruction *, uint64_t) {}
+    // instr committed this cycle
+    INSTRUMENTATION_HOOK void Retire(const Instruction *, uint64_t) {}
+};
+
+// Instructions entering each stage, printed with per-cycle rates at End()
+struct CounterInstrumentation : NoInstrumentation {
+    FILE *out;
+    uint64_t entered[STAGE_COUNT] = {};
+    uint64_t retired = 0;
+
+    explicit CounterInstrumentation(FILE *out = stderr) : out(out) {}
+
+    void End(Simulator &simulator);
+    void Enter(PipelineStage stage, const Instruction *, uint64_t) {entered[stage]++;}
+    void Retire(const Instruction *, uint64_t) {retired++;}
+};
+
+// The old DO_CYCLE and DO_LOG_STAGE output: latches, ROB, RMT and ARF every cycle, then each stage name
+struct CycleDumpInstrumentation : NoInstrumentation {
+    FILE *out;
+
+    explicit CycleDumpInstrumentation(FILE *out = stderr) : out(out) {}
+
+    void Cycle(Simulator &simulator) {simulator.Dump_State(out);}
+    void Stage(PipelineStage stage);
+};
+
+// The old DO_LOG_FILES output: one CSV per latch in dir, a snapshot of its contents every cycle
+struct LatchLogInstrumentation : NoInstrumentation {
+    std::string dir;
+
+    explicit LatchLogInstrumentation(const char *dir = "debug") : dir(dir) {}
+
+    void Begin(Simulator &simulator) {simulator.Start_Latch_Logs(dir.c_str());}
+    void End(Simulator &simulator) {simulator.End_Latch_Logs();}
+    void Cycle(Simulator &simulator) {simulator.Log_Latches();}
+};
+
+// One "<cycle> <stage> <seq>" line per stage entry and "<cycle> CM <seq>" per commit
+struct EventTraceInstrumentation : NoInstrumentation {
+    FILE *out;
+
+    explicit EventTraceInstrumentation(FILE *out = stderr) : out(out) {}
+
+    void Enter(PipelineStage stage, const Instruction *instr, uint64_t cycle) {
+        fprintf(out, "%llu %s %llu\n", (unsigned long long)cycle, pipeline_stage_str[stage],
+            (unsigned long long)instr->trace_line);
+    }
+    void Retire(const Instruction *instr, uint64_t cycle) {
+        fprintf(out, "%llu CM %llu\n", (unsigned long long)cycle, (unsigned long long)instr->trace_line);
+    }
+};
+
+#endif //ECE463_PROJ3_INSTRUMENTATION_H
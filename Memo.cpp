@@ -0,0 +1,88 @@
+#include "Memo.h"
+
+#include <algorithm>
+
+uint64_t LoopMemo::Hash(const std::vector<int64_t> &state) {
+    return Trace_Hash(state.data(), state.size() * sizeof(int64_t));
+}
+
+LoopMemo::LoopMemo()
+    :   m_last_pc(0),
+        m_iteration_count(0),
+        m_bytes(0),
+        m_recording(false),
+        m_current(),
+        m_lookups(0),
+        m_hits(0),
+        m_cycles_skipped(0),
+        m_instructions_skipped(0),
+        m_flushes(0) {}
+
+void LoopMemo::Begin_Recording(const std::vector<int64_t> &state, uint64_t cycle, uint64_t fetched, uint64_t retired,
+                               size_t rob_head) {
+    m_current.start = state;
+    m_current.window.clear();
+    m_current.emitted.clear();
+    m_current.emitted_tags.clear();
+    m_current.start_cycle = cycle;
+    m_current.start_rob_head = rob_head;
+    m_current.start_fetched = fetched;
+    m_current.retired = retired; // absolute until End_Recording()
+    m_recording = true;
+}
+
+void LoopMemo::End_Recording(const std::vector<int64_t> &state, uint64_t cycle, uint64_t retired, size_t rob_head) {
+    if (!m_recording) return;
+    m_recording = false;
+    if (cycle == m_current.start_cycle) return;
+    auto &iterations = m_table[Hash(m_current.start)];
+    for (auto &iteration : iterations) {
+        if (iteration.start == m_current.start && iteration.window.size() == m_current.window.size()
+            && std::equal(iteration.window.begin(), iteration.window.end(), m_current.window.begin(),
+                [](const TraceRecord &a, const TraceRecord &b) {
+                    return a.pc == b.pc && a.optype == b.optype && a.dst == b.dst && a.src1 == b.src1 && a.src2 == b.src2;
+                })) {
+            return; // already known
+        }
+    }
+    if (iterations.size() >= MEMO_MAX_PER_STATE) return;
+    iterations.reserve(MEMO_MAX_PER_STATE); // never moves, successor links point into it
+    m_current.end = state;
+    m_current.end_hash = Hash(state);
+    m_current.end_rob_head = rob_head;
+    m_current.cycles = cycle - m_current.start_cycle;
+    m_current.retired = retired - m_current.retired;
+    size_t bytes = (m_current.start.size() + m_current.end.size()) * sizeof(int64_t)
+        + m_current.window.size() * sizeof(TraceRecord)
+        + m_current.emitted.size() * (sizeof(TimingRecord) + sizeof(uint8_t));
+    if (m_bytes + bytes > MEMO_MAX_BYTES) {
+        m_table.clear();
+        m_iteration_count = 0;
+        m_bytes = 0;
+        m_flushes++;
+    }
+    m_table[Hash(m_current.start)].push_back(std::move(m_current));
+    m_current = MemoIteration();
+    m_iteration_count++;
+    m_bytes += bytes;
+}
+
+std::vector<MemoIteration> *LoopMemo::Find(uint64_t hash) {
+    m_lookups++;
+    auto it = m_table.find(hash);
+    return it == m_table.end() ? nullptr : &it->second;
+}
+
+void LoopMemo::Print(uint64_t total_cycles, FILE *out) const {
+    fprintf(out, "memo: %zu loop heads, %zu iterations recorded, %llu flushes\n", m_heads.size(), m_iteration_count,
+        (unsigned long long)m_flushes);
+    fprintf(out, "memo: %llu of %llu loop-head snapshots hit (%.1f%%), %llu of %llu cycles and %llu instructions fast-forwarded (%.1f%%)\n",
+        (unsigned long long)m_hits, (unsigned long long)m_lookups, m_lookups ? 100.0 * m_hits / m_lookups : 0.0,
+        (unsigned long long)m_cycles_skipped, (unsigned long long)total_cycles,
+        (unsigned long long)m_instructions_skipped, total_cycles ? 100.0 * m_cycles_skipped / total_cycles : 0.0);
+    // cycles actually simulated against the whole run, ignoring what the snapshots cost
+    if (total_cycles > m_cycles_skipped) {
+        fprintf(out, "memo: at most %.2fx fewer cycles simulated\n",
+            static_cast<double>(total_cycles) / (total_cycles - m_cycles_skipped));
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef ECE463_PROJ3_MEMO_H
+#define ECE463_PROJ3_MEMO_H
+#include <cstdint>
+#include <cstdio>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Simulator.h"
+#include "Trace.h"
+
+#define MEMO_MAX_BYTES (256ull << 20) // recorded iterations kept before the table is flushed
+#define MEMO_MAX_PER_STATE 4          // different trace windows remembered for one start state
+
+// One recorded loop iteration: from a start state at a loop head, fetching window moved the pipeline to end
+// in cycles cycles. States are Simulator::Save_State() words, relative to the cycle, fetch count and ROB head they
+// were taken at, so the iteration replays anywhere the same state meets the same upcoming instructions.
+struct MemoIteration {
+    std::vector<int64_t> start, end;
+    std::vector<TraceRecord> window;
+    std::vector<TimingRecord> emitted; // as printed during the recording, shifted on replay
+    std::vector<uint8_t> emitted_tags; // per emitted record, bit 0/1 set when src1/src2 is a ROB tag
+    uint64_t start_cycle, start_fetched;
+    size_t start_rob_head, end_rob_head; // ROB tags in emitted move with the head on replay
+    uint64_t cycles, retired;
+    uint64_t end_hash; // LoopMemo::Hash(end), so consecutive hits chain without rehashing
+    MemoIteration *successor = nullptr; // last iteration found to start at end, skips the state compare
+};
+
+// Steady-state loop memoization.
+// Targets of backward jumps in the pc stream are loop heads. Whenever the next instruction to fetch is a loop head
+// the simulator snapshots its state; the stretch until the next such snapshot is recorded as an iteration, and a
+// snapshot that matches a recorded start state, with the same instructions coming up, jumps straight to its end.
+class LoopMemo {
+    std::unordered_set<uint64_t> m_heads;
+    uint64_t m_last_pc;
+    std::unordered_map<uint64_t, std::vector<MemoIteration>> m_table; // by hash of the start state
+    size_t m_iteration_count, m_bytes;
+
+    bool m_recording;
+    MemoIteration m_current;
+
+    uint64_t m_lookups, m_hits, m_cycles_skipped, m_instructions_skipped, m_flushes;
+public:
+    LoopMemo();
+
+    // Every instruction handed to Fetch(), in order
+    void Fetched(const TraceRecord &record) {
+        if (record.pc < m_last_pc) m_heads.insert(record.pc);
+        m_last_pc = record.pc;
+        if (m_recording) m_current.window.push_back(record);
+    }
+    [[nodiscard]] bool Is_Head(uint64_t pc) const {return m_heads.count(pc) != 0;}
+
+    [[nodiscard]] bool Recording() const {return m_recording;}
+    void Emitted(const TimingRecord &record, uint8_t tags) {
+        if (!m_recording) return;
+        m_current.emitted.push_back(record);
+        m_current.emitted_tags.push_back(tags);
+    }
+    void Begin_Recording(const std::vector<int64_t> &state, uint64_t cycle, uint64_t fetched, uint64_t retired,
+                         size_t rob_head);
+    // Closes the open recording at a snapshot, if any
+    void End_Recording(const std::vector<int64_t> &state, uint64_t cycle, uint64_t retired, size_t rob_head);
+    void Abandon_Recording() {m_recording = false;}
+
+    static uint64_t Hash(const std::vector<int64_t> &state);
+    // Recorded iterations starting from a state with this hash, the caller still has to match state and window
+    std::vector<MemoIteration> *Find(uint64_t hash);
+    void Hit(const MemoIteration &iteration) {
+        m_hits++;
+        m_cycles_skipped += iteration.cycles;
+        m_instructions_skipped += iteration.window.size();
+    }
+
+    void Print(uint64_t total_cycles, FILE *out = stderr) const;
+};
+
+#endif //ECE463_PROJ3_MEMO_H
@@ -0,0 +1,94 @@
+#ifndef ECE463_PROJ3_RENAME_H
+#define ECE463_PROJ3_RENAME_H
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "Simulator.h"
+
+// Lanes renamed together, wider bundles are renamed in groups of this many
+#define RENAME_BUNDLE_LANES 16
+
+typedef std::array<int,ARCHITECTURAL_REGISTER_COUNT> RenameMapTable;
+
+// Maps one source through the RMT; sources without an in-flight producer (or -1) read the ARF
+inline void Rename_Source(const RenameMapTable &rmt, int &src, bool &meta) {
+    if (src >= 0 && rmt[src] >= 0) {
+        src = rmt[src];
+        meta = false;
+    } else {
+        meta = true; //arf
+    }
+}
+
+// Renames a bundle one instruction at a time, each seeing the RMT updates of the ones before it.
+// Every instruction must already hold its ROB slot in rob_index.
+inline void Rename_Sequential(RenameMapTable &rmt, Instruction **bundle, size_t count) {
+    for (size_t k = 0; k < count; k++) {
+        auto instr = bundle[k];
+        Rename_Source(rmt, instr->src1, instr->src1_meta);
+        Rename_Source(rmt, instr->src2, instr->src2_meta);
+        if (instr->dst >= 0) {
+            rmt[instr->dst] = instr->rob_index;
+        }
+    }
+}
+
+// Same result as Rename_Sequential() for up to RENAME_BUNDLE_LANES instructions.
+// Every source is looked up in the RMT up front, then a dst x src comparison matrix over the bundle
+// redirects sources written by an earlier lane to the last such writer's ROB slot.
+// Everything is selects rather than branches, so the unpredictable "is there a producer" checks of the
+// sequential version cost nothing, and no lane waits on the RMT store of the lane before it.
+inline void Rename_Lanes(RenameMapTable &rmt, Instruction **bundle, size_t count) {
+    int dst[RENAME_BUNDLE_LANES], src1[RENAME_BUNDLE_LANES], src2[RENAME_BUNDLE_LANES], rob[RENAME_BUNDLE_LANES];
+    int map1[RENAME_BUNDLE_LANES], map2[RENAME_BUNDLE_LANES];
+    int writer[RENAME_BUNDLE_LANES]; // dst, with "no dst" mapped to -2 so it never equals a source (>= -1)
+    for (size_t k = 0; k < count; k++) {
+        dst[k] = bundle[k]->dst;
+        writer[k] = dst[k] >= 0 ? dst[k] : -2;
+        src1[k] = bundle[k]->src1;
+        src2[k] = bundle[k]->src2;
+        rob[k] = static_cast<int>(bundle[k]->rob_index);
+        int mapped1 = rmt[src1[k] < 0 ? 0 : src1[k]];
+        int mapped2 = rmt[src2[k] < 0 ? 0 : src2[k]];
+        map1[k] = src1[k] < 0 ? -1 : mapped1;
+        map2[k] = src2[k] < 0 ? -1 : mapped2;
+    }
+
+    // row k of the matrix compares lane k's sources against the destinations of lanes 0..k-1,
+    // walking j upwards so the last writer wins
+    for (size_t k = 1; k < count; k++) {
+        int s1 = src1[k], s2 = src2[k], m1 = map1[k], m2 = map2[k];
+        for (size_t j = 0; j < k; j++) {
+            int hit1 = -static_cast<int>(writer[j] == s1); // all ones on a match, mask-select keeps it branch-free
+            int hit2 = -static_cast<int>(writer[j] == s2);
+            m1 = (rob[j] & hit1) | (m1 & ~hit1);
+            m2 = (rob[j] & hit2) | (m2 & ~hit2);
+        }
+        map1[k] = m1;
+        map2[k] = m2;
+    }
+
+    for (size_t k = 0; k < count; k++) {
+        auto instr = bundle[k];
+        int arf1 = map1[k] >> 31, arf2 = map2[k] >> 31; // all ones when the source reads the ARF
+        instr->src1 = (src1[k] & arf1) | (map1[k] & ~arf1);
+        instr->src1_meta = arf1 & 1; //arf
+        instr->src2 = (src2[k] & arf2) | (map2[k] & ~arf2);
+        instr->src2_meta = arf2 & 1; //arf
+    }
+
+    // ascending order leaves the last writer of each register in the RMT
+    for (size_t k = 0; k < count; k++) {
+        if (dst[k] >= 0) rmt[dst[k]] = rob[k];
+    }
+}
+
+inline void Rename_Bundle(RenameMapTable &rmt, Instruction **bundle, size_t count) {
+    for (size_t base = 0; base < count; base += RENAME_BUNDLE_LANES) {
+        size_t lanes = count - base < RENAME_BUNDLE_LANES ? count - base : RENAME_BUNDLE_LANES;
+        Rename_Lanes(rmt, bundle + base, lanes);
+    }
+}
+
+#endif //ECE463_PROJ3_RENAME_H
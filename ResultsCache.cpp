@@ -0,0 +1,154 @@
+#include "ResultsCache.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include <core_fingerprint.h>
+
+#include "Trace.h"
+
+#define RESULTS_CACHE_SUFFIX ".res"
+
+// mkdir -p
+static void MakeDirs(const std::string &dir) {
+    for (size_t i = 1; i <= dir.size(); i++) {
+        if (i == dir.size() || dir[i] == '/') {
+            mkdir(dir.substr(0, i).c_str(), 0755);
+        }
+    }
+}
+
+uint32_t Results_CoreFingerprint() {
+    return RESULTS_CORE_FINGERPRINT;
+}
+
+ResultsCache::ResultsCache(const std::string &dir, uint64_t max_bytes) : m_dir(dir), m_max_bytes(max_bytes) {
+    MakeDirs(m_dir);
+}
+
+std::string ResultsCache::DefaultDir() {
+    if (auto dir = getenv("SIM_CACHE_DIR")) return dir;
+    if (auto home = getenv("HOME")) return std::string(home) + "/.cache/ece463-sim";
+    return "/tmp/ece463-sim-cache";
+}
+
+std::string ResultsCache::Path(const ResultsKey &key) const {
+    uint64_t hash = Trace_Hash(&key.trace_hash, sizeof(key.trace_hash));
+    hash = Trace_Hash(&key.rob_size, sizeof(key.rob_size), hash);
+    hash = Trace_Hash(&key.iq_size, sizeof(key.iq_size), hash);
+    hash = Trace_Hash(&key.width, sizeof(key.width), hash);
+    hash = Trace_Hash(&key.core_fingerprint, sizeof(key.core_fingerprint), hash);
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx" RESULTS_CACHE_SUFFIX, (unsigned long long)hash);
+    return m_dir + name;
+}
+
+bool ResultsCache::Lookup(const ResultsKey &key, SimResult &result) {
+    auto path = Path(key);
+    FILE *file = fopen(path.c_str(), "r");
+    if (!file) return false;
+    unsigned long long trace_hash, instructions, cycles;
+    int rob_size, iq_size, width;
+    unsigned core_fingerprint;
+    bool hit = fscanf(file, "key %llx %d %d %d %x\n", &trace_hash, &rob_size, &iq_size, &width, &core_fingerprint) == 5
+        && trace_hash == key.trace_hash && core_fingerprint == key.core_fingerprint // the file name is only a hash, confirm the full key
+        && rob_size == key.rob_size && iq_size == key.iq_size && width == key.width
+        && fscanf(file, "result %llu %llu %lf\n", &instructions, &cycles, &result.ipc) == 3;
+    if (hit) {
+        result.instructions = instructions;
+        result.cycles = cycles;
+        result.stats.clear();
+        char chunk[4096];
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) result.stats.append(chunk, n);
+    }
+    fclose(file);
+    if (hit) utimensat(AT_FDCWD, path.c_str(), nullptr, 0); // mark as recently used
+    return hit;
+}
+
+void ResultsCache::Store(const ResultsKey &key, const SimResult &result) {
+    auto path = Path(key);
+    auto temp = path + "." + std::to_string(getpid()) + ".tmp";
+    FILE *file = fopen(temp.c_str(), "w");
+    if (!file) {
+        printf("ERROR: Failed to write results cache %s\n", temp.c_str());
+        return;
+    }
+    fprintf(file, "key %llx %d %d %d %x\n", (unsigned long long)key.trace_hash,
+        key.rob_size, key.iq_size, key.width, key.core_fingerprint);
+    fprintf(file, "result %llu %llu %.17g\n", (unsigned long long)result.instructions,
+        (unsigned long long)result.cycles, result.ipc);
+    fwrite(result.stats.data(), 1, result.stats.size(), file);
+    bool ok = !ferror(file);
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(temp.c_str(), path.c_str()) != 0) {
+        printf("ERROR: Failed to write results cache %s\n", path.c_str());
+        unlink(temp.c_str());
+        return;
+    }
+    if (EvictDue()) Evict();
+}
+
+// Bumps the shared store count, true on every RESULTS_CACHE_EVICT_INTERVAL-th store
+bool ResultsCache::EvictDue() {
+    auto count_path = m_dir + "/.stores";
+    int fd = open(count_path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return true; // no count to go by, scan like before
+    flock(fd, LOCK_EX);
+    uint64_t stores = 0;
+    if (pread(fd, &stores, sizeof(stores), 0) != sizeof(stores)) stores = 0;
+    stores++;
+    bool ok = pwrite(fd, &stores, sizeof(stores), 0) == sizeof(stores);
+    close(fd); // drops the lock
+    return !ok || stores % RESULTS_CACHE_EVICT_INTERVAL == 0;
+}
+
+void ResultsCache::Evict() {
+    struct Entry {
+        std::string path;
+        uint64_t bytes;
+        timespec used;
+    };
+    // one evictor at a time, writers and readers never need the lock
+    auto lock_path = m_dir + "/.lock";
+    int lock = open(lock_path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (lock < 0) return;
+    if (flock(lock, LOCK_EX | LOCK_NB) != 0) { // someone else is already evicting
+        close(lock);
+        return;
+    }
+
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    if (DIR *dir = opendir(m_dir.c_str())) {
+        size_t suffix = strlen(RESULTS_CACHE_SUFFIX);
+        while (auto ent = readdir(dir)) {
+            size_t length = strlen(ent->d_name);
+            if (length <= suffix || strcmp(ent->d_name + length - suffix, RESULTS_CACHE_SUFFIX) != 0) continue;
+            auto path = m_dir + "/" + ent->d_name;
+            struct stat st;
+            if (stat(path.c_str(), &st) != 0) continue;
+            entries.push_back({path, static_cast<uint64_t>(st.st_size), st.st_mtim});
+            total += st.st_size;
+        }
+        closedir(dir);
+    }
+    if (total > m_max_bytes) {
+        std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+            return a.used.tv_sec != b.used.tv_sec ? a.used.tv_sec < b.used.tv_sec : a.used.tv_nsec < b.used.tv_nsec;
+        });
+        for (auto &entry : entries) {
+            if (total <= m_max_bytes) break;
+            if (unlink(entry.path.c_str()) == 0) total -= entry.bytes;
+        }
+    }
+    close(lock);
+}
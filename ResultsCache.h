@@ -0,0 +1,59 @@
+#ifndef ECE463_PROJ3_RESULTSCACHE_H
+#define ECE463_PROJ3_RESULTSCACHE_H
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#define RESULTS_CACHE_MAX_BYTES (64ull << 20)
+// Stores between eviction scans, counted across every process sharing the directory
+#define RESULTS_CACHE_EVICT_INTERVAL 64
+
+struct SimResult {
+    uint64_t instructions;
+    uint64_t cycles;
+    double ipc;
+    std::string stats; // optional free-form blob stored verbatim, sim keeps its --instrument=counters report here
+
+    void Print(FILE *out = stdout) const {
+        fprintf(out, "# === Simulation Results ========\n");
+        fprintf(out, "# Dynamic Instruction Count    = %llu\n", (unsigned long long)instructions);
+        fprintf(out, "# Cycles                       = %llu\n", (unsigned long long)cycles);
+        fprintf(out, "# Instructions Per Cycle (IPC) = %.2f\n", ipc);
+    }
+};
+
+// Hash of the core sources taken at build time, so any edit to the core retires old entries.
+// Generated into core_fingerprint.h by the Makefile (cksum) and CMake (cmake/CoreFingerprint.cmake).
+uint32_t Results_CoreFingerprint();
+
+// Everything a cached result depends on: the trace content, the config and the core.
+// How the trace is read (--shm-trace, --async-io, --memoize, libsim's Feed()) must not change a result,
+// tests/trace_sources.sh holds those to a plain run, so sim, simsearch and sweep workers share entries.
+struct ResultsKey {
+    uint64_t trace_hash;
+    int rob_size, iq_size, width;
+    uint32_t core_fingerprint = Results_CoreFingerprint();
+};
+
+// On-disk results, one small file per key in a shared directory.
+// Entries are published with an atomic rename, so concurrent writers of the same key just race to identical content.
+// Hits refresh the entry's mtime. Every RESULTS_CACHE_EVICT_INTERVAL stores one of them scans the directory and,
+// if it exceeds max_bytes, evicts the least recently used entries, so it may overshoot by that many entries.
+class ResultsCache {
+    std::string m_dir;
+    uint64_t m_max_bytes;
+
+    [[nodiscard]] std::string Path(const ResultsKey &key) const;
+    bool EvictDue();
+    void Evict();
+public:
+    explicit ResultsCache(const std::string &dir = DefaultDir(), uint64_t max_bytes = RESULTS_CACHE_MAX_BYTES);
+
+    bool Lookup(const ResultsKey &key, SimResult &result);
+    void Store(const ResultsKey &key, const SimResult &result);
+
+    // $SIM_CACHE_DIR, else ~/.cache/ece463-sim
+    static std::string DefaultDir();
+};
+
+#endif //ECE463_PROJ3_RESULTSCACHE_H
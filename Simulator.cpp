@@ -4,114 +4,180 @@
 
 #include "Simulator.h"
 
-#define DO_LOG_STAGE false
-#define LOG_STAGE if(DO_LOG_STAGE) printf
+#include "AsyncIO.h"
+#include "Heartbeat.h"
+#include "Instrumentation.h"
+#include "Memo.h"
+#include "Rename.h"
 
-#define DO_CYCLE false
-
-#define DO_LOG_FILES false
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 
 void Simulator::Run() {
-    int i = 0;
-    if (DO_LOG_FILES) {
-        m_pipeline_di.StartLog("debug/dispatch.csv");
-        m_pipeline_rn.StartLog("debug/rename.csv");
-        m_pipeline_de.StartLog("debug/decode.csv");
-        m_pipeline_rr.StartLog("debug/regread.csv");
-        m_pipeline_wb.StartLog("debug/writeback.csv");
-    }
-    do {
-        //printf("%d\n",i);
-        if (DO_CYCLE) {
-            if (i == 10)break;
-            printf("%d\n",i);
-            printf("\tDecode\n");
-            m_pipeline_de.Print();
-            printf("\tRename\n");
-            m_pipeline_rn.Print();
-            printf("\tRegRead\n");
-            m_pipeline_rr.Print();
-            printf("\tDispatch\n");
-            m_pipeline_di.Print();
-            printf("\tROB\n");
-            m_rob.Print();
-            printf("\tRMT\n");
-            for (auto &r : m_rmt) {
-                printf("%d, ",r);
-            }
-            printf("\n\tARF\n");
-            for (auto &r : m_arf) {
-                printf("%d, ",r);
-            }
+    NoInstrumentation none;
+    Run(none);
+}
+
+uint64_t Simulator::Step(uint64_t cycles) {
+    NoInstrumentation none;
+    return Step(cycles, none);
+}
+
+template <typename Policy>
+void Simulator::Run(Policy &policy) {
+    policy.Begin(*this);
+    while (Tick(policy));
+    policy.End(*this);
+}
+
+template <typename Policy>
+uint64_t Simulator::Step(uint64_t cycles, Policy &policy) {
+    uint64_t stepped = 0;
+    while (stepped < cycles && !m_done) {
+        stepped++;
+        if (!Tick(policy)) break;
+    }
+    return stepped;
+}
+
+void Simulator::Feed(const TraceRecord *records, size_t count) {
+    if (!m_memory) {
+        printf("ERROR: Feeding a simulator that reads a trace file\n");
+        return;
+    }
+    m_memory->Feed(records, count);
+}
+
+void Simulator::CloseInput() {
+    if (m_memory) m_memory->Close();
+}
+
+void Simulator::SetHeartbeat(Heartbeat *heartbeat) {
+    m_heartbeat = heartbeat;
+    m_heartbeat_cycle = heartbeat ? m_cycle_count + HEARTBEAT_POLL_CYCLES : UINT64_MAX;
+}
+
+// One cycle, returns false once the simulation is done
+template <typename Policy>
+bool Simulator::Tick(Policy &policy) {
+    policy.Cycle(*this);
+
+    Retire(policy);
+    Writeback(policy);
+    Execute(policy);
+    Issue(policy);
+    Dispatch(policy);
+    RegRead(policy);
+    Rename(policy);
+    Decode(policy);
+    Fetch(policy);
+
+    return Advance_Cycle();
+}
+
+void Simulator::Dump_State(FILE *out) {
+    fprintf(out,"%llu\n",(unsigned long long)m_cycle_count);
+    fprintf(out,"\tDecode\n");
+    m_pipeline_de.Print(out);
+    fprintf(out,"\tRename\n");
+    m_pipeline_rn.Print(out);
+    fprintf(out,"\tRegRead\n");
+    m_pipeline_rr.Print(out);
+    fprintf(out,"\tDispatch\n");
+    m_pipeline_di.Print(out);
+    fprintf(out,"\tROB\n");
+    m_rob.Print(out);
+    fprintf(out,"\tRMT\n");
+    for (auto &r : m_rmt) {
+        fprintf(out,"%d, ",r);
+    }
+    fprintf(out,"\n\tARF\n");
+    for (auto &r : m_arf) {
+        fprintf(out,"%d, ",r);
+    }
+    fprintf(out,"\n");
+    fprintf(out,"m_pipeline_rr.available: %d\n",m_pipeline_rr.available());
+    fprintf(out,"m_rob.available: %zu\n",m_rob.available());
+    fprintf(out,"m_pipeline_rn.m_element_count: %zu\n",m_pipeline_rn.m_element_count);
+}
+
+void Simulator::Start_Latch_Logs(const char *dir) {
+    std::string prefix = std::string(dir) + "/";
+    m_pipeline_di.StartLog((prefix + "dispatch.csv").c_str());
+    m_pipeline_rn.StartLog((prefix + "rename.csv").c_str());
+    m_pipeline_de.StartLog((prefix + "decode.csv").c_str());
+    m_pipeline_rr.StartLog((prefix + "regread.csv").c_str());
+    m_pipeline_wb.StartLog((prefix + "writeback.csv").c_str());
+}
+
+void Simulator::Log_Latches() {
+    m_pipeline_wb.Log();
+    m_pipeline_rr.Log();
+    m_pipeline_de.Log();
+    m_pipeline_rn.Log();
+    m_pipeline_di.Log();
+}
+
+void Simulator::End_Latch_Logs() {
+    m_pipeline_di.EndLog();
+    m_pipeline_rn.EndLog();
+    m_pipeline_de.EndLog();
+    m_pipeline_rr.EndLog();
+    m_pipeline_wb.EndLog();
+}
+
+template <typename Policy>
+void Simulator::Retire(Policy &policy) {
+    policy.Stage(STAGE_RT);
+    auto retired = m_rob.retire(m_width, m_retire_bundle.data());
+    m_retired_count += retired;
+    m_retired.clear();
+    for (size_t i = 0; i < retired; i++) {
+        auto instr = m_retire_bundle[i];
+        if (instr->dst >= 0 && m_rmt[instr->dst] == static_cast<int>(instr->rob_index)) {
+            m_rmt[instr->dst] = -1; // later readers find the value in the ARF
         }
-        if (DO_LOG_FILES) {
-            m_pipeline_wb.Log();
-            m_pipeline_rr.Log();
-            m_pipeline_de.Log();
-            m_pipeline_rn.Log();
-            m_pipeline_di.Log();
-        }
-        i++;
-
-        Retire();
-        Writeback();
-        Execute();
-        Issue();
-        Dispatch();
-        RegRead();
-        Rename();
-        Decode();
-        Fetch();
-
-    }while(Advance_Cycle());
-    if (DO_LOG_FILES) {
-        m_pipeline_di.EndLog();
-        m_pipeline_rn.EndLog();
-        m_pipeline_de.EndLog();
-        m_pipeline_rr.EndLog();
-        m_pipeline_wb.EndLog();
-    }
-}
-
-void Simulator::Retire() {
-    LOG_STAGE("Retire\n");
-    int instructions_retired = 0;
-    while (instructions_retired <= m_width) {
-        auto retired = m_rob.retire();
-        if (!retired.valid) break;
-        auto instr = m_pipeline_rt.pop();
         instr->rt_length = m_cycle_count - instr->rt_begin;
-        instr->Print_Timing();
+        policy.Retire(instr, m_cycle_count);
+        Emit(instr);
+        if (m_retire_callback) m_retired.push_back(instr->Timing());
         delete instr;
     }
+    if (m_retire_callback && !m_retired.empty()) {
+        m_retire_callback(m_retired.data(), m_retired.size(), m_retire_user);
+    }
 
 
 
 }
 
 
-void Simulator::Writeback() {
-    LOG_STAGE("Writeback\n");
-    while (!m_pipeline_wb.empty() && !m_pipeline_rt.full()) {
+template <typename Policy>
+void Simulator::Writeback(Policy &policy) {
+    policy.Stage(STAGE_WB);
+    while (!m_pipeline_wb.empty()) { // the ROB slot holds the instruction until it retires
         auto instr = m_pipeline_wb.pop();
         instr->wb_length = m_cycle_count - instr->wb_begin;
         instr->rt_begin = m_cycle_count;
-        m_pipeline_rt.push(instr);
-
+        m_rob.set_ready(instr->rob_index);
+        policy.Enter(STAGE_RT, instr, m_cycle_count);
     }
 }
 
 
-void Simulator::Execute() {
-    LOG_STAGE("Execute\n");
+template <typename Policy>
+void Simulator::Execute(Policy &policy) {
+    policy.Stage(STAGE_EX);
     while (!m_pipeline_wb.full() && !m_execute_list.empty()) {
         auto exec = m_execute_list.GetOldest();
-        exec->wb_begin = m_cycle_count;
-        exec->ex_length = m_cycle_count - exec->ex_length;
-        if (!exec->valid) {
+        if (!exec) { // nothing has finished executing yet
             break;
         }
+        exec->wb_begin = m_cycle_count;
+        exec->ex_length = m_cycle_count - exec->ex_begin;
+        policy.Enter(STAGE_WB, exec, m_cycle_count);
         m_pipeline_wb.push(exec);
 
         // wake up
@@ -119,41 +185,40 @@ void Simulator::Execute() {
 }
 
 
-void Simulator::Issue() {
-    LOG_STAGE("Issue\n");
+template <typename Policy>
+void Simulator::Issue(Policy &policy) {
+    policy.Stage(STAGE_IS);
     int instructions_issued = 0;
     while (!m_execute_list.full() && !m_iq.empty()  && instructions_issued < m_width) {
         auto instr = m_iq.GetOldest();
         instr->iq_length = m_cycle_count - instr->iq_begin;
         instr->ex_begin = m_cycle_count;
 
-
-        if (instr->valid) {
-            m_execute_list.push(instr);
-            instructions_issued++;
-        } else {
-            break;
-        }
-
+        policy.Enter(STAGE_EX, instr, m_cycle_count);
+        m_execute_list.push(instr);
+        instructions_issued++;
     }
 }
 
-void Simulator::Dispatch() {
-    LOG_STAGE("Dispatch\n");
+template <typename Policy>
+void Simulator::Dispatch(Policy &policy) {
+    policy.Stage(STAGE_DI);
     if (m_iq.available() >= m_pipeline_di.m_element_count) {
         while (!m_pipeline_di.empty()) {
             auto instr = m_pipeline_di.pop();
             instr->di_length = m_cycle_count - instr->di_begin;
             instr->iq_begin = m_cycle_count;
 
+            policy.Enter(STAGE_IS, instr, m_cycle_count);
             m_iq.push(instr); //ready = meta
         }
     }
 }
 
 
-void Simulator::RegRead() {
-    LOG_STAGE("RegRead\n");
+template <typename Policy>
+void Simulator::RegRead(Policy &policy) {
+    policy.Stage(STAGE_RR);
     if (!m_pipeline_di.full()) {
         while (!m_pipeline_rr.empty()) {
             auto instr = m_pipeline_rr.pop();
@@ -161,62 +226,53 @@ void Simulator::RegRead() {
             instr->di_begin = m_cycle_count;
             instr->src1_meta = instr->src1_meta ? true : m_rob[instr->src1].ready; // if arf, ready, else, read rob
             instr->src2_meta = instr->src2_meta ? true : m_rob[instr->src2].ready; // if arf, ready, else, read rob
-            instr->Print_Timing();
+            Emit(instr);
+            policy.Enter(STAGE_DI, instr, m_cycle_count);
             m_pipeline_di.push(instr);
         }
     }
 }
 
 
-void Simulator::Rename() {
-    LOG_STAGE("Rename\n");
-    if (DO_CYCLE) {
-        printf("m_pipeline_rr.available: %d\n",m_pipeline_rr.available());
-        printf("m_rob.available: %d\n",m_rob.available());
-        printf("m_pipeline_rn.m_element_count: %d\n",m_pipeline_rn.m_element_count);
-    }
+template <typename Policy>
+void Simulator::Rename(Policy &policy) {
+    policy.Stage(STAGE_RN);
     if (m_pipeline_rr.available() >= m_pipeline_rn.m_element_count && m_rob.available() >= m_pipeline_rn.m_element_count) {
+        m_rename_bundle.clear();
         while (!m_pipeline_rn.empty()) {
             auto instr = m_pipeline_rn.pop();
             instr->rn_length = m_cycle_count - instr->rn_begin;
             instr->rr_begin = m_cycle_count;
-            if (m_rmt[instr->src1] >= 0) {
-                instr->src1 = m_rmt[instr->src1];
-                instr->src1_meta = false;
-            }else {
-                instr->src1_meta = true; //arf
-            }
-
-            if (m_rmt[instr->src2] >= 0) {
-                instr->src2 = m_rmt[instr->src2];
-                instr->src2_meta = false;
-            }else {
-                instr->src2_meta = true; //arf
-            }
-
-            auto index = m_rob.push({
+            instr->rob_index = m_rob.push({
                 instr->dst,
                 true,
             false,
             false,
             false,
-            instr->pc});
+            instr->pc,
+            instr});
+            m_rename_bundle.push_back(instr);
+        }
+        Rename_Sequential(m_rmt, m_rename_bundle.data(), m_rename_bundle.size());
+        for (auto instr : m_rename_bundle) {
+            instr->src1_tag = !instr->src1_meta;
+            instr->src2_tag = !instr->src2_meta;
+            policy.Enter(STAGE_RR, instr, m_cycle_count);
             m_pipeline_rr.push(instr);
-            if (instr->dst >= 0) {
-                m_rmt[instr->dst] = index;
-            }
         }
     }
 }
 
 
-void Simulator::Decode() {
-    LOG_STAGE("Decode\n");
+template <typename Policy>
+void Simulator::Decode(Policy &policy) {
+    policy.Stage(STAGE_DE);
     if (m_pipeline_rn.empty()) {
         while (!m_pipeline_de.empty()) {
             auto instr = m_pipeline_de.pop();
             instr->de_length = m_cycle_count - instr->de_begin;
             instr->rn_begin = m_cycle_count;
+            policy.Enter(STAGE_RN, instr, m_cycle_count);
             m_pipeline_rn.push(instr);
         }
 
@@ -224,29 +280,350 @@ void Simulator::Decode() {
 }
 
 
-void Simulator::Fetch() {
-    LOG_STAGE("Fetch\n");
-    if (m_pipeline_de.empty() && !feof(m_trace_file)) {
-        while (!m_pipeline_de.full() && !feof(m_trace_file)) {
-            auto instr = new Instruction(m_trace_file);
+template <typename Policy>
+void Simulator::Fetch(Policy &policy) {
+    policy.Stage(STAGE_FE);
+    if (m_pipeline_de.empty() && !Input_Done()) {
+        TraceRecord record;
+        while (!m_pipeline_de.full() && Next_Record(record)) {
+            auto instr = new Instruction(record, m_fetched_count++);
             instr->fe_begin = m_cycle_count-1;
             instr->fe_length = 1;
             instr->de_begin = m_cycle_count;
+            policy.Enter(STAGE_FE, instr, instr->fe_begin);
+            policy.Enter(STAGE_DE, instr, m_cycle_count);
             m_pipeline_de.push(instr);
         }
 
     }
-    if (feof(m_trace_file)) {
-        fclose(m_trace_file);
+    if (Input_Done()) {
         m_done = true;
     }
 }
 
+bool Simulator::Next_Record(TraceRecord &record) {
+    if (!m_lookahead.empty()) {
+        record = m_lookahead.front();
+        m_lookahead.pop_front();
+    } else if (m_peeked_end) {
+        m_peeked_end = false; // the failed read Fetch() would have made
+        return false;
+    } else if (!m_trace->Next(record)) {
+        return false;
+    }
+    if (m_memo) m_memo->Fetched(record);
+    return true;
+}
+
+// Reads ahead until count records are waiting, returns false if the trace ends first
+bool Simulator::Peek(size_t count) {
+    TraceRecord record;
+    while (m_lookahead.size() < count && !m_peeked_end) {
+        bool done = m_trace->Done();
+        if (!m_trace->Next(record)) {
+            m_peeked_end = !done;
+            break;
+        }
+        m_lookahead.push_back(record);
+    }
+    return m_lookahead.size() >= count;
+}
+
+// Stage begin cycles relative to cycle, 0 (not reached yet) kept apart from every real offset
+static int64_t Relative_Begin(uint32_t begin, uint64_t cycle) {
+    return begin == 0 ? INT64_MIN : static_cast<int32_t>(begin - static_cast<uint32_t>(cycle));
+}
+
+static uint32_t Absolute_Begin(int64_t begin, uint64_t cycle) {
+    return begin == INT64_MIN ? 0 : static_cast<uint32_t>(cycle) + static_cast<uint32_t>(begin);
+}
+
+// Words: instruction count, the latches, the IQ and execute list entries by age, the occupied ROB entries from the
+// head, the RMT, then each in-flight instruction. Instructions are numbered by age, pointers are saved as those
+// numbers. Only what decides the rest of the run is kept: queue slot positions are left out, and ROB slots are
+// offsets from the head, so the same loop state matches wherever it sits in the ROB. A slot a ROB tag points to
+// carries its ready flag, which is all RegRead() reads there, also from slots a retired instruction left behind.
+void Simulator::Save_State(std::vector<int64_t> &state) const {
+    const Buffer *latches[] = {&m_pipeline_de, &m_pipeline_rn, &m_pipeline_rr, &m_pipeline_di, &m_pipeline_wb};
+    std::vector<const Instruction*> in_flight;
+    for (auto latch : latches) in_flight.insert(in_flight.end(), latch->m_data.begin(), latch->m_data.end());
+    for (auto instr : m_iq.m_instructions) if (instr) in_flight.push_back(instr);
+    for (auto &exec : m_execute_list.m_instructions) if (exec.instr) in_flight.push_back(exec.instr);
+    std::unordered_map<const Instruction*, int64_t> rob_slots; // offset from the head of each renamed instruction
+    for (size_t i = 0; i < m_rob.m_element_count; i++) {
+        auto instr = m_rob.m_rob[(m_rob.m_head + i) & m_rob.m_mask].instr;
+        in_flight.push_back(instr);
+        rob_slots[instr] = i;
+    }
+    std::sort(in_flight.begin(), in_flight.end(), [](const Instruction *a, const Instruction *b) {
+        return a->trace_line < b->trace_line;
+    });
+    in_flight.erase(std::unique(in_flight.begin(), in_flight.end()), in_flight.end());
+    std::unordered_map<const Instruction*, int64_t> ids;
+    for (size_t i = 0; i < in_flight.size(); i++) ids[in_flight[i]] = i;
+    auto id = [&](const Instruction *instr) -> int64_t {return instr ? ids[instr] : -1;};
+    auto push_tag = [&](int tag) {
+        state.push_back((tag - m_rob.m_head) & m_rob.m_mask);
+        state.push_back(m_rob.m_rob[tag].ready);
+    };
+
+    state.clear();
+    state.push_back(in_flight.size());
+    for (auto latch : latches) {
+        state.push_back(latch->m_element_count);
+        state.push_back(latch->m_data.size());
+        for (auto instr : latch->m_data) state.push_back(id(instr));
+    }
+    std::vector<int64_t> queued;
+    for (auto instr : m_iq.m_instructions) if (instr) queued.push_back(id(instr));
+    std::sort(queued.begin(), queued.end());
+    state.push_back(queued.size());
+    state.insert(state.end(), queued.begin(), queued.end());
+    std::vector<std::pair<int64_t, int64_t>> executing;
+    for (auto &exec : m_execute_list.m_instructions) if (exec.instr) executing.emplace_back(id(exec.instr), exec.counter);
+    std::sort(executing.begin(), executing.end());
+    state.push_back(executing.size());
+    for (auto &exec : executing) {
+        state.push_back(exec.first);
+        state.push_back(exec.second);
+    }
+    state.push_back(m_rob.m_element_count);
+    for (size_t i = 0; i < m_rob.m_element_count; i++) {
+        auto &entry = m_rob.m_rob[(m_rob.m_head + i) & m_rob.m_mask];
+        state.push_back(entry.dst);
+        state.push_back(entry.valid | entry.ready << 1 | entry.exec << 2 | entry.miss << 3);
+        state.push_back(entry.pc);
+        state.push_back(id(entry.instr));
+    }
+    for (auto r : m_rmt) {
+        if (r < 0) {
+            state.push_back(-1);
+        } else {
+            push_tag(r);
+        }
+    }
+    for (auto instr : in_flight) {
+        state.push_back(instr->pc);
+        state.push_back(instr->optype);
+        state.push_back(instr->dst);
+        state.push_back(instr->src1_meta | instr->src2_meta << 1 | instr->valid << 2 | instr->src1_tag << 3
+            | instr->src2_tag << 4);
+        for (auto [src, tag] : {std::make_pair(instr->src1, instr->src1_tag), std::make_pair(instr->src2, instr->src2_tag)}) {
+            if (tag) {
+                push_tag(src);
+            } else {
+                state.push_back(src);
+            }
+        }
+        state.push_back(static_cast<int64_t>(instr->trace_line - m_fetched_count));
+        auto slot = rob_slots.find(instr);
+        state.push_back(slot == rob_slots.end() ? -1 : slot->second);
+        for (auto begin : {instr->fe_begin, instr->de_begin, instr->rn_begin, instr->rr_begin, instr->di_begin,
+                           instr->iq_begin, instr->ex_begin, instr->wb_begin, instr->rt_begin}) {
+            state.push_back(Relative_Begin(begin, m_cycle_count));
+        }
+        for (auto length : {instr->fe_length, instr->de_length, instr->rn_length, instr->rr_length, instr->di_length,
+                            instr->iq_length, instr->ex_length, instr->wb_length, instr->rt_length}) {
+            state.push_back(length);
+        }
+    }
+}
+
+// Replaces the pipeline with a Save_State() image, m_cycle_count and m_fetched_count must already be the new ones
+void Simulator::Load_State(const std::vector<int64_t> &state, size_t rob_head) {
+    Buffer *latches[] = {&m_pipeline_de, &m_pipeline_rn, &m_pipeline_rr, &m_pipeline_di, &m_pipeline_wb};
+    std::unordered_set<Instruction*> old;
+    for (auto latch : latches) old.insert(latch->m_data.begin(), latch->m_data.end());
+    for (auto instr : m_iq.m_instructions) if (instr) old.insert(instr);
+    for (auto &exec : m_execute_list.m_instructions) if (exec.instr) old.insert(exec.instr);
+    for (auto &entry : m_rob.m_rob) if (entry.instr) old.insert(entry.instr);
+    for (auto instr : old) delete instr;
+
+    size_t word = 0;
+    auto next = [&] {return state[word++];};
+    std::vector<Instruction*> in_flight(next());
+    for (auto &instr : in_flight) instr = new Instruction();
+    auto instr_at = [&](int64_t id) {return id < 0 ? nullptr : in_flight[id];};
+    auto next_tag = [&] {
+        int tag = static_cast<int>((rob_head + next()) & m_rob.m_mask);
+        m_rob.m_rob[tag].ready = next();
+        return tag;
+    };
+
+    for (auto latch : latches) {
+        latch->m_element_count = next();
+        latch->m_data.resize(next());
+        for (auto &instr : latch->m_data) instr = instr_at(next());
+    }
+    m_iq.m_element_count = next();
+    for (size_t i = 0; i < m_iq.m_instructions.size(); i++) {
+        m_iq.m_instructions[i] = i < m_iq.m_element_count ? instr_at(next()) : nullptr;
+    }
+    m_execute_list.m_element_count = next();
+    for (size_t i = 0; i < m_execute_list.m_instructions.size(); i++) {
+        auto &exec = m_execute_list.m_instructions[i];
+        if (i < m_execute_list.m_element_count) {
+            exec.instr = instr_at(next());
+            exec.counter = static_cast<int>(next());
+        } else {
+            exec = {0, nullptr};
+        }
+    }
+    m_rob.m_head = rob_head;
+    m_rob.m_element_count = next();
+    m_rob.m_tail = (rob_head + m_rob.m_element_count) & m_rob.m_mask;
+    for (auto &entry : m_rob.m_rob) entry = {-1, false, false, false, false, 0, nullptr};
+    for (auto &ready : m_rob.m_ready) ready = 0;
+    for (size_t i = 0; i < m_rob.m_element_count; i++) {
+        size_t slot = (rob_head + i) & m_rob.m_mask;
+        auto &entry = m_rob.m_rob[slot];
+        entry.dst = static_cast<int>(next());
+        auto flags = next();
+        entry.valid = flags & 1;
+        entry.ready = flags & 2;
+        entry.exec = flags & 4;
+        entry.miss = flags & 8;
+        entry.pc = next();
+        entry.instr = instr_at(next());
+        if (entry.ready) m_rob.set_ready(slot);
+    }
+    for (auto &r : m_rmt) {
+        r = state[word] < 0 ? static_cast<int>(next()) : next_tag();
+    }
+    for (auto instr : in_flight) {
+        instr->pc = next();
+        instr->optype = static_cast<int>(next());
+        instr->dst = static_cast<int>(next());
+        auto flags = next();
+        instr->src1_meta = flags & 1;
+        instr->src2_meta = flags & 2;
+        instr->valid = flags & 4;
+        instr->src1_tag = flags & 8;
+        instr->src2_tag = flags & 16;
+        instr->src1 = instr->src1_tag ? next_tag() : static_cast<int>(next());
+        instr->src2 = instr->src2_tag ? next_tag() : static_cast<int>(next());
+        instr->trace_line = m_fetched_count + next();
+        auto slot = next();
+        instr->rob_index = slot < 0 ? 0 : static_cast<uint32_t>((rob_head + slot) & m_rob.m_mask);
+        for (auto begin : {&instr->fe_begin, &instr->de_begin, &instr->rn_begin, &instr->rr_begin, &instr->di_begin,
+                           &instr->iq_begin, &instr->ex_begin, &instr->wb_begin, &instr->rt_begin}) {
+            *begin = Absolute_Begin(next(), m_cycle_count);
+        }
+        for (auto length : {&instr->fe_length, &instr->de_length, &instr->rn_length, &instr->rr_length, &instr->di_length,
+                            &instr->iq_length, &instr->ex_length, &instr->wb_length, &instr->rt_length}) {
+            *length = static_cast<uint32_t>(next());
+        }
+    }
+}
+
+// Between cycles: snapshots the pipeline when the next instruction to fetch is a loop head, closes the recording
+// that led here, then replays recorded iterations for as long as state and upcoming instructions match one.
+// Consecutive hits only emit timings, the pipeline is rebuilt once from the last one.
+void Simulator::Memo_Boundary() {
+    if (m_fetched_count == m_memo_fetched || !Peek(1) || !m_memo->Is_Head(m_lookahead.front().pc)) return;
+    m_memo_fetched = m_fetched_count;
+    Save_State(m_memo_state);
+    m_memo->End_Recording(m_memo_state, m_cycle_count, m_retired_count, m_rob.m_head);
+
+    const std::vector<int64_t> *state = &m_memo_state;
+    size_t rob_head = m_rob.m_head; // where the ROB head would be after the iterations replayed so far
+    uint64_t hash = LoopMemo::Hash(m_memo_state);
+    MemoIteration *last = nullptr;
+    while (auto iterations = m_memo->Find(hash)) {
+        MemoIteration *hit = nullptr;
+        for (auto &iteration : *iterations) {
+            size_t count = iteration.window.size();
+            // one record past the window, so the trace does not run out during the iteration either
+            if (!Peek(count + 1)) continue;
+            if (!(last && last->successor == &iteration) && iteration.start != *state) continue;
+            if (std::equal(iteration.window.begin(), iteration.window.end(), m_lookahead.begin(),
+                    [](const TraceRecord &a, const TraceRecord &b) {
+                        return a.pc == b.pc && a.optype == b.optype && a.dst == b.dst && a.src1 == b.src1 && a.src2 == b.src2;
+                    })) {
+                hit = &iteration;
+                break;
+            }
+        }
+        if (!hit) break;
+
+        uint32_t cycle_shift = static_cast<uint32_t>(m_cycle_count - hit->start_cycle);
+        uint64_t line_shift = m_fetched_count - hit->start_fetched;
+        size_t rob_shift = rob_head - hit->start_rob_head;
+        for (size_t i = 0; i < hit->emitted.size(); i++) {
+            TimingRecord shifted = hit->emitted[i];
+            shifted.trace_line += line_shift;
+            if (hit->emitted_tags[i] & 1) shifted.src1 = static_cast<int>((shifted.src1 + rob_shift) & m_rob.m_mask);
+            if (hit->emitted_tags[i] & 2) shifted.src2 = static_cast<int>((shifted.src2 + rob_shift) & m_rob.m_mask);
+            for (auto begin : {&shifted.fe_begin, &shifted.de_begin, &shifted.rn_begin, &shifted.rr_begin, &shifted.di_begin,
+                               &shifted.iq_begin, &shifted.ex_begin, &shifted.wb_begin, &shifted.rt_begin}) {
+                if (*begin) *begin += cycle_shift;
+            }
+            Emit(shifted);
+        }
+        for (size_t i = 0; i < hit->window.size(); i++) {
+            m_memo->Fetched(m_lookahead.front());
+            m_lookahead.pop_front();
+        }
+        m_cycle_count += hit->cycles;
+        m_fetched_count += hit->window.size();
+        m_retired_count += hit->retired;
+        rob_head = (rob_head + hit->end_rob_head - hit->start_rob_head) & m_rob.m_mask;
+        m_memo->Hit(*hit);
+        if (last) last->successor = hit;
+        last = hit;
+        state = &hit->end;
+        hash = hit->end_hash;
+    }
+    if (last) {
+        Load_State(*state, rob_head);
+        m_memo_state = *state;
+        m_memo_fetched = m_fetched_count;
+    }
+    m_memo->Begin_Recording(m_memo_state, m_cycle_count, m_fetched_count, m_retired_count, m_rob.m_head);
+}
+
 
 bool Simulator::Advance_Cycle() {
     m_execute_list.Increment();
     m_cycle_count++;
+    if (m_memo) Memo_Boundary();
+    if (m_cycle_count >= m_heartbeat_cycle) Poll_Heartbeat(); // the only heartbeat cost on the cycle path
     return !m_done;
 }
 
 
+void Simulator::Poll_Heartbeat() {
+    m_heartbeat_cycle = m_cycle_count + HEARTBEAT_POLL_CYCLES;
+    m_heartbeat->Poll(*this);
+}
+
+
+void Simulator::Emit(const Instruction *instr) {
+    if (m_memo && m_memo->Recording()) m_memo->Emitted(instr->Timing(), instr->src1_tag | instr->src2_tag << 1);
+    if (m_writer) {
+        m_writer->Push(instr->Timing());
+    } else if (m_out) {
+        instr->Print_Timing(m_out);
+    }
+}
+
+void Simulator::Emit(const TimingRecord &record) {
+    if (m_writer) {
+        m_writer->Push(record);
+    } else if (m_out) {
+        record.Print(m_out);
+    }
+}
+
+
+// Every policy main() can select
+template void Simulator::Run(NoInstrumentation &);
+template void Simulator::Run(CounterInstrumentation &);
+template void Simulator::Run(CycleDumpInstrumentation &);
+template void Simulator::Run(LatchLogInstrumentation &);
+template void Simulator::Run(EventTraceInstrumentation &);
+template uint64_t Simulator::Step(uint64_t, NoInstrumentation &);
+template uint64_t Simulator::Step(uint64_t, CounterInstrumentation &);
+template uint64_t Simulator::Step(uint64_t, CycleDumpInstrumentation &);
+template uint64_t Simulator::Step(uint64_t, LatchLogInstrumentation &);
+template uint64_t Simulator::Step(uint64_t, EventTraceInstrumentation &);
@@ -4,18 +4,28 @@
 
 #ifndef ECE463_PROJ3_SIMULATOR_H
 #define ECE463_PROJ3_SIMULATOR_H
+#include <algorithm>
 #include <array>
+#include <cassert>
 #include <cstdint>
 #include <cstdio>
 #include <vector>
-#include <queue>
+#include <deque>
+
+#include "Trace.h"
 #define ARCHITECTURAL_REGISTER_COUNT 67
 
+class Heartbeat;
+class Instruction;
+class LoopMemo;
+class TimingWriter;
+
 
 struct ROBEntry {
     int dst;
     bool valid, ready,exec, miss;
     uint64_t pc;
+    Instruction *instr; // handed to Retire() when the slot commits
 
     void Print_Header(FILE *out = stdout) {
         fprintf(out,"dst,valid,ready,exec,miss,pc\n");
@@ -26,15 +36,46 @@ struct ROBEntry {
 };
 
 
-inline uint64_t g_trace_line = 0;
+// Per-instruction timing as printed at retire, detached from the Instruction so it can cross threads
+struct TimingRecord {
+    uint64_t trace_line;
+    int optype;
+    int src1, src2, dst;
+    uint32_t fe_begin, fe_length;
+    uint32_t de_begin, de_length;
+    uint32_t rn_begin, rn_length;
+    uint32_t rr_begin, rr_length;
+    uint32_t di_begin, di_length;
+    uint32_t iq_begin, iq_length;
+    uint32_t ex_begin, ex_length;
+    uint32_t wb_begin, wb_length;
+    uint32_t rt_begin, rt_length;
+
+    void Print(FILE *out = stdout) const {
+        fprintf(out,"%llu fu{%d} src{%d,%d} dst{%d} FE{%d,%d} DE{%d,%d} RN{%d,%d} RR{%d,%d} DI{%d,%d} IS{%d,%d} EX{%d,%d} WB{%d,%d} RT{%d,%d}\n",
+        (unsigned long long)trace_line, optype, src1, src2, dst,
+        fe_begin, fe_length,
+de_begin, de_length,
+rn_begin, rn_length,
+rr_begin, rr_length,
+di_begin, di_length,
+iq_begin, iq_length,
+ex_begin, ex_length,
+wb_begin, wb_length,
+rt_begin, rt_length);
+    }
+};
+
 class Instruction{
 public:
     uint64_t pc;
     int optype;
     int dst, src1, src2;
     bool src1_meta, src2_meta;
+    bool src1_tag, src2_tag; // renamed to a ROB slot, src1_meta/src2_meta only say whether it was ready at RegRead
     uint64_t trace_line;
     bool valid;
+    uint32_t rob_index;
 
     uint32_t fe_begin, fe_length;
     uint32_t de_begin, de_length;
@@ -48,7 +89,9 @@ public:
 
 
 
-    Instruction(FILE *trace_file) : valid(true),
+    Instruction(const TraceRecord &record, uint64_t trace_line) : pc(record.pc), optype(record.optype),
+    dst(record.dst), src1(record.src1), src2(record.src2), src1_meta(false), src2_meta(false),
+    src1_tag(false), src2_tag(false), trace_line(trace_line), valid(true), rob_index(0),
     fe_begin(0), fe_length(0),
 de_begin(0), de_length(0),
 rn_begin(0), rn_length(0),
@@ -59,8 +102,6 @@ ex_begin(0), ex_length(0),
 wb_begin(0), wb_length(0),
 rt_begin(0), rt_length(0)
         {
-        fscanf(trace_file, "%lx %d %d %d %d", &pc, &optype, &dst, &src1, &src2);
-        trace_line = g_trace_line++;
     }
 
     Instruction() : valid(false) {
@@ -86,13 +127,12 @@ rt_begin(0), rt_length(0)
         fprintf(out,"%llx,%d,%d,%d,%d,%d,%d,%llu,%d\n",pc,optype,dst,src1,src2,src1_meta,src2_meta,trace_line,valid);
     }
 
-    void Print_Header(FILE *out = stdout) {
+    static void Print_Header(FILE *out = stdout) {
         fprintf(out,"pc,optype,dst,src1,src2,src1_meta,src2_meta,timestamp,valid\n");
     }
 
-    void Print_Timing() {
-        printf("%llu fu{%d} src{%d,%d} dst{%d} FE{%d,%d} DE{%d,%d} RN{%d,%d} RR{%d,%d} DI{%d,%d} IS{%d,%d} EX{%d,%d} WB{%d,%d} RT{%d,%d}\n",
-        trace_line, optype, src1, src2,
+    TimingRecord Timing() const {
+        return {trace_line, optype, src1, src2, dst,
         fe_begin, fe_length,
 de_begin, de_length,
 rn_begin, rn_length,
@@ -101,20 +141,26 @@ di_begin, di_length,
 iq_begin, iq_length,
 ex_begin, ex_length,
 wb_begin, wb_length,
-rt_begin, rt_length);
+rt_begin, rt_length};
+    }
+
+    void Print_Timing(FILE *out = stdout) const {
+        Timing().Print(out);
     }
 
 };
 
 class Buffer {
-    std::queue<Instruction*> m_data;
+    std::deque<Instruction*> m_data; // a deque rather than a std::queue so Log() and Print() can walk it in place
+    friend class Simulator; // Save_State() and Load_State()
 public:
 
     size_t m_element_count;
     const size_t m_max_element_count;
     Buffer(size_t max_element_count)
         : m_max_element_count(max_element_count),
-        m_element_count(0) {};
+        m_element_count(0),
+        m_log_file(nullptr) {};
 
     Buffer& operator=(Buffer&& other) noexcept {
         if (this != &other) {
@@ -138,7 +184,7 @@ public:
             return;
         }
         m_element_count++;
-        m_data.push(entry);
+        m_data.push_back(entry);
     }
     Instruction* pop() {
         if (empty()) {
@@ -147,36 +193,38 @@ public:
         }
         m_element_count--;
         auto val = m_data.front();
-        m_data.pop();
+        m_data.pop_front();
         return val;
     }
 
     FILE *m_log_file;
-    void StartLog(char *path) {
+    void StartLog(const char *path) {
         m_log_file = fopen(path,"w");
-        m_data.front()->Print_Header(m_log_file);
+        if (!m_log_file) {
+            printf("ERROR: Failed to open log file %s\n",path);
+            return;
+        }
+        Instruction::Print_Header(m_log_file);
 
     }
 
     void EndLog() {
-        fclose(m_log_file);
+        if (m_log_file) fclose(m_log_file);
+        m_log_file = nullptr;
     }
 
     void Log() {
-        std::queue<Instruction*> temp = m_data;
-        while (!temp.empty()) {
-            temp.front()->Print(m_log_file);
-            temp.pop();
+        if (!m_log_file) return;
+        for (auto instr : m_data) {
+            instr->Print(m_log_file);
         }
     }
 
     void Print(FILE *out = stdout) {
-        fprintf(out,"%llu/%llu instructions\n",m_element_count,m_max_element_count);
-        m_data.front()->Print_Header(out);
-        std::queue<Instruction*> temp = m_data;
-        while (!temp.empty()) {
-            temp.front()->Print(out);
-            temp.pop();
+        fprintf(out,"%zu/%zu instructions\n",m_element_count,m_max_element_count);
+        Instruction::Print_Header(out);
+        for (auto instr : m_data) {
+            instr->Print(out);
         }
     }
 
@@ -254,6 +302,7 @@ struct ExecuteEntry {
 class ExecuteList {
     std::vector<ExecuteEntry> m_instructions;
     size_t m_max_element_count, m_element_count;
+    friend class Simulator;
 public:
     ExecuteList(int size) : m_max_element_count(size), m_element_count(0){
         m_instructions.resize(size);
@@ -262,7 +311,7 @@ public:
     void push(Instruction* instr) {
         m_element_count++;
         for (auto &i:m_instructions) {
-            if (!i.instr->valid) {
+            if (!i.instr) {
                 i = {0,instr};
                 i.instr->valid = false;
                 return;
@@ -296,18 +345,20 @@ public:
         }
     }
 
+    // Removes the oldest instruction that has finished executing, nullptr while none has. Its slot is freed.
     Instruction* GetOldest() {
 
         uint64_t oldest_timestamp = UINT64_MAX;
-        int oldest_index = 0;
+        int oldest_index = -1;
         for (int i = 0; i < m_instructions.size(); i++) {
-            if (i==0 || (m_instructions[i].instr->trace_line < oldest_timestamp && m_instructions[i].instr->valid)) {
+            if (m_instructions[i].instr && m_instructions[i].instr->valid && m_instructions[i].instr->trace_line < oldest_timestamp) {
                 oldest_timestamp = m_instructions[i].instr->trace_line;
                 oldest_index = i;
             }
         }
+        if (oldest_index < 0) return nullptr;
         auto val = m_instructions[oldest_index].instr;
-        m_instructions[oldest_index].instr->valid = false;
+        m_instructions[oldest_index].instr = nullptr;
         m_element_count--;
         return val;
     }
@@ -316,6 +367,7 @@ public:
 class IssueQueue {
     std::vector<Instruction*> m_instructions;
     size_t m_max_element_count, m_element_count;
+    friend class Simulator;
 public:
     IssueQueue(int iq_size) : m_max_element_count(iq_size), m_element_count(0){
         m_instructions.resize(iq_size);
@@ -324,7 +376,7 @@ public:
     void push(Instruction* instr) {
         m_element_count++;
         for (auto &i:m_instructions) {
-            if (!i || !i->valid) {
+            if (!i) {
                 i = instr;
                 return;
             }
@@ -344,124 +396,314 @@ public:
         return m_max_element_count - m_element_count;
     }
 
+    [[nodiscard]] size_t size() const {
+        return m_element_count;
+    }
+
+    // Removes the oldest instruction, nullptr if the queue is empty. Its slot is freed.
     Instruction* GetOldest() {
-        m_element_count--;
         uint64_t oldest_timestamp = UINT64_MAX;
-        int oldest_index = 0;
+        int oldest_index = -1;
         for (int i = 0; i < m_instructions.size(); i++) {
-            if (i==0 || (m_instructions[i] && m_instructions[i]->trace_line < oldest_timestamp && m_instructions[i]->valid)) {
+            if (m_instructions[i] && m_instructions[i]->trace_line < oldest_timestamp) {
                 oldest_timestamp = m_instructions[i]->trace_line;
                 oldest_index = i;
             }
         }
+        if (oldest_index < 0) return nullptr;
         auto val = m_instructions[oldest_index];
-        m_instructions[oldest_index]->valid = false;
+        m_instructions[oldest_index] = nullptr;
+        m_element_count--;
         return val;
     }
 };
 
 
 
+// Circular ROB with a power-of-two backing store and one ready bit per slot.
+// Only m_max_element_count slots are ever occupied, the rest of the store is slack from rounding up.
 class ReorderBuffer {
     std::vector<ROBEntry> m_rob;
+    std::vector<uint64_t> m_ready;
     size_t m_max_element_count, m_element_count;
+    size_t m_mask;
     size_t m_head,m_tail;
+    friend class Simulator;
+
+    static size_t Capacity(size_t size) {
+        size_t capacity = 64; // at least one full word of ready bits
+        while (capacity < size) capacity <<= 1;
+        return capacity;
+    }
+
+    // Length of the run of set ready bits starting at slot, stopping at limit or the end of the store
+    size_t ReadyRun(size_t slot, size_t limit) const {
+        size_t run = 0;
+        while (run < limit && slot < m_rob.size()) {
+            size_t offset = slot & 63;
+            auto bits = ~(m_ready[slot >> 6] >> offset);
+            size_t word_run = bits ? __builtin_ctzll(bits) : 64;
+            run += word_run;
+            if (word_run < 64 - offset) break;
+            slot += word_run;
+        }
+        return std::min(run, limit);
+    }
+
+    void ClearReady(size_t slot, size_t count) {
+        while (count > 0) {
+            size_t offset = slot & 63;
+            size_t bits = std::min<size_t>(count, 64 - offset);
+            uint64_t mask = bits == 64 ? ~0ull : ((1ull << bits) - 1) << offset;
+            m_ready[slot >> 6] &= ~mask;
+            slot = (slot + bits) & m_mask;
+            count -= bits;
+        }
+    }
 public:
-    ReorderBuffer(int size) : m_max_element_count(size), m_element_count(0), m_head(0), m_tail(0){
-        m_rob.resize(size);
+    ReorderBuffer(int size) : m_max_element_count(size), m_element_count(0), m_mask(Capacity(size) - 1), m_head(0), m_tail(0){
+        m_rob.resize(m_mask + 1);
+        m_ready.resize((m_mask + 1) / 64);
     }
 
     ROBEntry& operator[](int index) {
         return m_rob[index];
     }
 
+    // The caller stalls until there is room, pushing to a full ROB would overwrite the head
     size_t push(ROBEntry entry) {
+        assert(!full());
         m_element_count++;
-        m_rob[m_tail] = entry;
-        m_tail++;
-        return m_tail-1;
-    }
-
-    ROBEntry retire() {
-        if (m_rob[m_head].ready == 1) {
-            auto val = m_rob[m_head];
-            m_rob[m_head].valid = 0;
-            m_head++;
-            return val;
-        }else {
-            return{0,false,false,false,false,0};
+        auto index = m_tail;
+        m_rob[index] = entry;
+        m_tail = (m_tail + 1) & m_mask;
+        return index;
+    }
+
+    void set_ready(size_t index) {
+        m_rob[index].ready = true;
+        m_ready[index >> 6] |= 1ull << (index & 63);
+    }
+
+    // Commits the ready prefix at the head, at most max_count entries, and returns how many were committed.
+    // The committed slots' instructions are moved to retired, oldest first.
+    size_t retire(size_t max_count, Instruction **retired) {
+        size_t limit = std::min(max_count, m_element_count);
+        size_t count = ReadyRun(m_head, limit);
+        if (count < limit && m_head + count == m_rob.size()) { // run reached the end of the store, continue at slot 0
+            count += ReadyRun(0, limit - count);
+        }
+        for (size_t i = 0, slot = m_head; i < count; i++, slot = (slot + 1) & m_mask) {
+            retired[i] = m_rob[slot].instr;
+            m_rob[slot].instr = nullptr;
         }
+        ClearReady(m_head, count);
+        m_head = (m_head + count) & m_mask;
+        m_element_count -= count;
+        return count;
     }
 
     bool full() {
         return m_max_element_count == m_element_count;
     }
 
+    bool empty() {
+        return m_element_count == 0;
+    }
+
     size_t available() {
         return m_max_element_count - m_element_count;
     }
 
+    [[nodiscard]] size_t size() const {
+        return m_element_count;
+    }
+
     void Print(FILE *out = stdout) {
         m_rob[0].Print_Header(out);
-        for (int i = m_head; i!=m_tail;i = (i + 1)%m_max_element_count) {
-            m_rob[i].Print(out);
+        for (size_t i = 0, slot = m_head; i < m_element_count; i++, slot = (slot + 1) & m_mask) {
+            m_rob[slot].Print(out);
         }
     }
 
 
 };
 
+#define SIM_MAX_CONFIG (1 << 20) // largest ROB_SIZE, IQ_SIZE or WIDTH, a mistyped size would allocate gigabytes
+
+struct SimConfig {
+    int rob_size;
+    int iq_size;
+    int width;
+
+    // Every size between 1 and SIM_MAX_CONFIG
+    [[nodiscard]] bool Valid() const {
+        return rob_size > 0 && rob_size <= SIM_MAX_CONFIG && iq_size > 0 && iq_size <= SIM_MAX_CONFIG
+            && width > 0 && width <= SIM_MAX_CONFIG;
+    }
+};
+
+// Receives the timing of every instruction retired in one cycle, in program order
+typedef void (*RetireCallback)(const TimingRecord *records, size_t count, void *user);
+
 class Simulator {
     uint32_t m_rob_size, m_iq_size, m_width;
-    FILE *m_trace_file;
+    TraceSource *m_trace;
+    MemoryTraceSource *m_memory; // same object as m_trace when fed through Feed(), else null
     uint64_t m_cycle_count;
+    uint64_t m_retired_count;
+    uint64_t m_fetched_count;
 
     ReorderBuffer m_rob;
     IssueQueue m_iq;
 
     bool m_done;
+    FILE *m_out;
+    TimingWriter *m_writer;
+    RetireCallback m_retire_callback;
+    void *m_retire_user;
+    std::vector<TimingRecord> m_retired;
+    Heartbeat *m_heartbeat;
+    uint64_t m_heartbeat_cycle; // next cycle to poll m_heartbeat at, UINT64_MAX without one
+    LoopMemo *m_memo;
+    uint64_t m_memo_fetched; // fetch count at the last loop-head snapshot, one snapshot per loop head reached
+    std::vector<int64_t> m_memo_state;
+    std::deque<TraceRecord> m_lookahead; // records read from m_trace but not fetched yet
+    bool m_peeked_end; // a peek found the end of a trace that only reports Done() after a failed Next()
 
     ExecuteList m_execute_list;
-    Buffer m_pipeline_de,m_pipeline_rn,m_pipeline_rr, m_pipeline_di, m_pipeline_wb, m_pipeline_rt;
+    Buffer m_pipeline_de,m_pipeline_rn,m_pipeline_rr, m_pipeline_di, m_pipeline_wb;
     std::array<int,ARCHITECTURAL_REGISTER_COUNT> m_rmt, m_arf;
+    std::vector<Instruction*> m_rename_bundle;
+    std::vector<Instruction*> m_retire_bundle;
 public:
     Simulator(int rob_size, int iq_size, int width, char* tracefile)
+        :   Simulator(rob_size, iq_size, width, new FileTraceSource(tracefile)) {}
+
+    // Takes ownership of trace
+    Simulator(int rob_size, int iq_size, int width, TraceSource *trace)
         :   m_rob_size(rob_size),
             m_iq_size(iq_size),
             m_width(width),
+            m_trace(trace),
+            m_memory(nullptr),
+            m_cycle_count(0),
+            m_retired_count(0),
+            m_fetched_count(0),
+            m_rob(rob_size),
+            m_iq(iq_size),
+            m_done(false),
+            m_out(stdout),
+            m_writer(nullptr),
+            m_retire_callback(nullptr),
+            m_retire_user(nullptr),
+            m_heartbeat(nullptr),
+            m_heartbeat_cycle(UINT64_MAX),
+            m_memo(nullptr),
+            m_memo_fetched(UINT64_MAX),
+            m_peeked_end(false),
+            m_execute_list(width * 5),
             m_pipeline_de(width),
             m_pipeline_rn(width),
-            m_rob(rob_size),
             m_pipeline_rr(width),
             m_pipeline_di(width),
-            m_iq(iq_size),
-            m_execute_list(width * 5),
             m_pipeline_wb(width),
-            m_done(false),
-            m_cycle_count(0),
-    m_pipeline_rt(width){
-        m_trace_file = fopen(tracefile, "r");
-        if (!m_trace_file) {
-            printf("ERROR: Failed to open tracefile\n");
-        }
+            m_retire_bundle(width){
         for (auto &r : m_rmt) r = -1; //invalidate rmt
+        m_rename_bundle.reserve(width);
+    }
+
+    // Embedded use: instructions arrive through Feed(), nothing is printed unless SetOutput() is called
+    explicit Simulator(const SimConfig &config)
+        :   Simulator(config.rob_size, config.iq_size, config.width, new MemoryTraceSource()) {
+        m_memory = static_cast<MemoryTraceSource*>(m_trace);
+        m_out = nullptr;
+    }
+
+    ~Simulator() {
+        delete m_trace;
     }
 
 
     void Run();
 
+    // Runs at most cycles cycles, stopping early once the simulation is done. Returns the cycles run.
+    uint64_t Step(uint64_t cycles);
+
+    // Same, with the hooks of an instrumentation policy from Instrumentation.h (instantiated in Simulator.cpp).
+    // Step() does not call the policy's Begin() and End().
+    template <typename Policy> void Run(Policy &policy);
+    template <typename Policy> uint64_t Step(uint64_t cycles, Policy &policy);
+    [[nodiscard]] bool Done() const {return m_done;}
+
+    // Only for simulators built from a SimConfig
+    void Feed(const TraceRecord *records, size_t count);
+    void CloseInput();
+
+    // Timing text goes to out, nullptr disables it
+    void SetOutput(FILE *out) {m_out = out;}
+
+    // Called once per cycle with that cycle's retired instructions, the records are only valid during the call
+    void SetRetireCallback(RetireCallback callback, void *user) {
+        m_retire_callback = callback;
+        m_retire_user = user;
+    }
+
+    [[nodiscard]] uint64_t GetCycleCount() const {return m_cycle_count;}
+    [[nodiscard]] uint64_t GetRetiredCount() const {return m_retired_count;}
+    [[nodiscard]] uint64_t GetFetchedCount() const {return m_fetched_count;}
+    [[nodiscard]] size_t GetROBOccupancy() const {return m_rob.size();}
+    [[nodiscard]] size_t GetIQOccupancy() const {return m_iq.size();}
+    [[nodiscard]] double GetTraceProgress() const {return m_trace->Progress();}
+    [[nodiscard]] SimConfig GetConfig() const {
+        return {static_cast<int>(m_rob_size), static_cast<int>(m_iq_size), static_cast<int>(m_width)};
+    }
+
+    // Polls heartbeat every HEARTBEAT_POLL_CYCLES cycles, nullptr disables it. heartbeat is not owned.
+    void SetHeartbeat(Heartbeat *heartbeat);
+
+    // Fast-forwards repeated loop iterations through memo, nullptr disables it. memo is not owned.
+    // Replayed timings reach the output and the timing writer, but not the retire callback or instrumentation hooks,
+    // and Step() can overshoot by the length of one replayed iteration.
+    void SetMemo(LoopMemo *memo) {m_memo = memo;}
+
+    // Hands timing output to writer's thread instead of printing inline, writer is not owned
+    void SetTimingWriter(TimingWriter *writer) {m_writer = writer;}
+
+    // Debug output behind CycleDumpInstrumentation and LatchLogInstrumentation
+    void Dump_State(FILE *out);
+    void Start_Latch_Logs(const char *dir);
+    void Log_Latches();
+    void End_Latch_Logs();
+
 private:
 
-    void Retire();
-    void Writeback();
-    void Execute();
-    void Issue();
-    void Dispatch();
-    void RegRead();
-    void Rename();
-    void Decode();
-    void Fetch();
+    template <typename Policy> void Retire(Policy &policy);
+    template <typename Policy> void Writeback(Policy &policy);
+    template <typename Policy> void Execute(Policy &policy);
+    template <typename Policy> void Issue(Policy &policy);
+    template <typename Policy> void Dispatch(Policy &policy);
+    template <typename Policy> void RegRead(Policy &policy);
+    template <typename Policy> void Rename(Policy &policy);
+    template <typename Policy> void Decode(Policy &policy);
+    template <typename Policy> void Fetch(Policy &policy);
+    template <typename Policy> bool Tick(Policy &policy);
     bool Advance_Cycle();
+    void Emit(const Instruction *instr);
+    void Emit(const TimingRecord &record);
+    void Poll_Heartbeat();
+
+    // Trace input through the lookahead
+    bool Next_Record(TraceRecord &record);
+    bool Peek(size_t count);
+    // Done() as Fetch() would have seen it without the lookahead, so the run ends on the same cycle
+    [[nodiscard]] bool Input_Done() const {return m_lookahead.empty() && !m_peeked_end && m_trace->Done();}
+
+    // Complete pipeline state as words relative to the current cycle, fetch count and ROB head, and back.
+    // Load_State() puts the ROB head at rob_head.
+    void Save_State(std::vector<int64_t> &state) const;
+    void Load_State(const std::vector<int64_t> &state, size_t rob_head);
+    void Memo_Boundary();
 
 };
 
@@ -0,0 +1,53 @@
+#ifndef ECE463_PROJ3_SPSCRING_H
+#define ECE463_PROJ3_SPSCRING_H
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Lock-free ring for exactly one producer thread and one consumer thread.
+// Capacity is rounded up to a power of two; head and tail run freely and are masked on access.
+template <typename T>
+class SpscRing {
+    std::vector<T> m_data;
+    size_t m_mask;
+    alignas(64) std::atomic<size_t> m_head; // next slot to pop, written by the consumer
+    alignas(64) std::atomic<size_t> m_tail; // next slot to push, written by the producer
+    alignas(64) size_t m_cached_head;       // producer's last view of m_head
+    alignas(64) size_t m_cached_tail;       // consumer's last view of m_tail
+public:
+    explicit SpscRing(size_t max_element_count) : m_head(0), m_tail(0), m_cached_head(0), m_cached_tail(0) {
+        size_t capacity = 2;
+        while (capacity < max_element_count) capacity <<= 1;
+        m_data.resize(capacity);
+        m_mask = capacity - 1;
+    }
+
+    bool push(const T &entry) {
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_cached_head > m_mask) {
+            m_cached_head = m_head.load(std::memory_order_acquire);
+            if (tail - m_cached_head > m_mask) return false;
+        }
+        m_data[tail & m_mask] = entry;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &entry) {
+        auto head = m_head.load(std::memory_order_relaxed);
+        if (head == m_cached_tail) {
+            m_cached_tail = m_tail.load(std::memory_order_acquire);
+            if (head == m_cached_tail) return false;
+        }
+        entry = m_data[head & m_mask];
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Only exact when called from the consumer with the producer stopped
+    bool empty() const {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+};
+
+#endif //ECE463_PROJ3_SPSCRING_H
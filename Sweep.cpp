@@ -0,0 +1,270 @@
+#include "Sweep.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "ResultsCache.h"
+#include "Simulator.h"
+
+std::string SweepJob::Encode() const {
+    char head[96];
+    snprintf(head, sizeof(head), "JOB %llu %d %d %d ", (unsigned long long)id, rob_size, iq_size, width);
+    return head + trace;
+}
+
+bool SweepJob::Decode(const std::string &message, SweepJob &job) {
+    unsigned long long id;
+    int offset = 0;
+    if (sscanf(message.c_str(), "JOB %llu %d %d %d %n", &id, &job.rob_size, &job.iq_size, &job.width, &offset) != 4
+        || !offset) {
+        return false;
+    }
+    job.id = id;
+    job.trace = message.substr(offset); // the rest of the line, paths may contain spaces
+    return !job.trace.empty();
+}
+
+bool SweepJob::Valid() const {
+    return SimConfig{rob_size, iq_size, width}.Valid();
+}
+
+std::string SweepResult::Encode() const {
+    char text[160];
+    if (!error.empty()) {
+        snprintf(text, sizeof(text), "ERROR %llu ", (unsigned long long)id);
+        return text + error;
+    }
+    snprintf(text, sizeof(text), "RESULT %llu %llu %llu %.6f %d %.3f", (unsigned long long)id,
+        (unsigned long long)instructions, (unsigned long long)cycles, ipc, stalled, seconds);
+    return text;
+}
+
+bool SweepResult::Decode(const std::string &message, SweepResult &result) {
+    unsigned long long id, instructions, cycles;
+    int stalled, offset = 0;
+    result.error.clear();
+    if (sscanf(message.c_str(), "ERROR %llu %n", &id, &offset) == 1 && offset) {
+        result.id = id;
+        result.error = message.substr(offset);
+        if (result.error.empty()) result.error = "unknown error";
+        return true;
+    }
+    if (sscanf(message.c_str(), "RESULT %llu %llu %llu %lf %d %lf", &id, &instructions, &cycles, &result.ipc,
+            &stalled, &result.seconds) != 6) {
+        return false;
+    }
+    result.id = id;
+    result.instructions = instructions;
+    result.cycles = cycles;
+    result.stalled = stalled;
+    return true;
+}
+
+// Fills a sockaddr for "unix:<path>" or "<host>:<port>", an empty host means every interface
+static bool Resolve(const char *address, sockaddr_storage &storage, socklen_t &length, bool passive) {
+    memset(&storage, 0, sizeof(storage));
+    if (!strncmp(address, "unix:", 5)) {
+        auto un = reinterpret_cast<sockaddr_un*>(&storage);
+        if (strlen(address + 5) >= sizeof(un->sun_path)) {
+            fprintf(stderr, "Socket path too long: %s\n", address + 5);
+            return false;
+        }
+        un->sun_family = AF_UNIX;
+        strcpy(un->sun_path, address + 5);
+        length = sizeof(sockaddr_un);
+        return true;
+    }
+    const char *colon = strrchr(address, ':');
+    if (!colon) {
+        fprintf(stderr, "Bad address `%s', expected unix:<path> or <host>:<port>\n", address);
+        return false;
+    }
+    std::string host(address, colon - address);
+    addrinfo hints = {}, *info = nullptr;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (passive) hints.ai_flags = AI_PASSIVE;
+    int error = getaddrinfo(host.empty() ? nullptr : host.c_str(), colon + 1, &hints, &info);
+    if (error || !info) {
+        fprintf(stderr, "Cannot resolve `%s': %s\n", address, gai_strerror(error));
+        return false;
+    }
+    memcpy(&storage, info->ai_addr, info->ai_addrlen);
+    length = info->ai_addrlen;
+    freeaddrinfo(info);
+    return true;
+}
+
+int Sweep_Listen(const char *address) {
+    sockaddr_storage storage;
+    socklen_t length;
+    if (!Resolve(address, storage, length, true)) return -1;
+    int fd = socket(storage.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    if (storage.ss_family == AF_UNIX) {
+        unlink(reinterpret_cast<sockaddr_un*>(&storage)->sun_path); // left behind by an earlier run
+    } else {
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    }
+    if (bind(fd, reinterpret_cast<sockaddr*>(&storage), length) < 0 || listen(fd, 64) < 0) {
+        fprintf(stderr, "Cannot listen on `%s': %s\n", address, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int Sweep_Connect(const char *address) {
+    sockaddr_storage storage;
+    socklen_t length;
+    if (!Resolve(address, storage, length, false)) return -1;
+    int fd = socket(storage.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, reinterpret_cast<sockaddr*>(&storage), length) < 0) {
+        close(fd);
+        return -1;
+    }
+    if (storage.ss_family != AF_UNIX) {
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)); // messages are tiny and request/response
+    }
+    return fd;
+}
+
+bool Sweep_Send(int fd, const std::string &message) {
+    if (message.size() > SWEEP_MAX_MESSAGE) return false;
+    uint32_t length = message.size();
+    unsigned char head[4] = {static_cast<unsigned char>(length), static_cast<unsigned char>(length >> 8),
+                             static_cast<unsigned char>(length >> 16), static_cast<unsigned char>(length >> 24)};
+    std::string frame(reinterpret_cast<char*>(head), 4);
+    frame += message;
+    for (size_t sent = 0; sent < frame.size();) {
+        auto n = send(fd, frame.data() + sent, frame.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        sent += n;
+    }
+    return true;
+}
+
+static bool ReadFully(int fd, char *data, size_t length) {
+    while (length > 0) {
+        auto n = read(fd, data, length);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        length -= n;
+    }
+    return true;
+}
+
+bool Sweep_Receive(int fd, std::string &message) {
+    unsigned char head[4];
+    if (!ReadFully(fd, reinterpret_cast<char*>(head), 4)) return false;
+    uint32_t length = head[0] | head[1] << 8 | head[2] << 16 | static_cast<uint32_t>(head[3]) << 24;
+    if (length > SWEEP_MAX_MESSAGE) return false;
+    message.resize(length);
+    return ReadFully(fd, &message[0], length);
+}
+
+int Sweep_Extract(std::string &buffer, std::string &message) {
+    if (buffer.size() < 4) return 0;
+    auto head = reinterpret_cast<const unsigned char*>(buffer.data());
+    uint32_t length = head[0] | head[1] << 8 | head[2] << 16 | static_cast<uint32_t>(head[3]) << 24;
+    if (length > SWEEP_MAX_MESSAGE) return -1;
+    if (buffer.size() < 4 + length) return 0;
+    message = buffer.substr(4, length);
+    buffer.erase(0, 4 + length);
+    return 1;
+}
+
+// One job, in process, with the same stall cutoff as simsearch
+static SweepResult Simulate(const SweepJob &job, ResultsCache *cache) {
+    SweepResult result = {job.id, 0, 0, 0.0, false, 0.0, ""};
+    auto start = std::chrono::steady_clock::now();
+    if (!job.Valid()) { // a coordinator that skipped the check must not make the worker allocate a huge ROB
+        result.error = "ROB_SIZE, IQ_SIZE and WIDTH must be between 1 and " + std::to_string(SIM_MAX_CONFIG);
+        return result;
+    }
+
+    auto trace = new FileTraceSource(job.trace.c_str());
+    if (!trace->IsOpen()) {
+        delete trace;
+        result.error = "cannot read trace " + job.trace;
+        return result;
+    }
+    ResultsKey key{0, job.rob_size, job.iq_size, job.width};
+    if (cache && Trace_HashFile(job.trace.c_str(), &key.trace_hash)) {
+        SimResult cached;
+        if (cache->Lookup(key, cached)) {
+            delete trace;
+            result.instructions = cached.instructions;
+            result.cycles = cached.cycles;
+            result.ipc = cached.ipc;
+            return result;
+        }
+    }
+
+    Simulator simulator(job.rob_size, job.iq_size, job.width, trace);
+    simulator.SetOutput(nullptr);
+    uint64_t last_retired = 0, last_progress = 0;
+    while (!simulator.Done()) {
+        simulator.Step(SWEEP_STEP_CYCLES);
+        if (simulator.GetRetiredCount() != last_retired) {
+            last_retired = simulator.GetRetiredCount();
+            last_progress = simulator.GetCycleCount();
+        } else if (simulator.GetCycleCount() - last_progress >= SWEEP_STALL_CYCLES) {
+            result.stalled = true;
+            break;
+        }
+    }
+    result.instructions = simulator.GetRetiredCount();
+    result.cycles = simulator.GetCycleCount();
+    if (result.cycles) result.ipc = static_cast<double>(result.instructions) / result.cycles;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (cache && key.trace_hash && !result.stalled) {
+        cache->Store(key, {result.instructions, result.cycles, result.ipc});
+    }
+    return result;
+}
+
+int Sweep_Worker(const char *address) {
+    int fd = Sweep_Connect(address);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot connect to coordinator at `%s'\n", address);
+        return 1;
+    }
+    if (!Sweep_Send(fd, "HELLO " + std::to_string(getpid()))) {
+        close(fd);
+        return 1;
+    }
+    // Same cache as sim, opt in with SIM_CACHE_DIR
+    ResultsCache *cache = getenv("SIM_CACHE_DIR") ? new ResultsCache() : nullptr;
+    std::string message;
+    while (Sweep_Receive(fd, message) && message != "QUIT") {
+        SweepJob job;
+        SweepResult result;
+        if (SweepJob::Decode(message, job)) {
+            result = Simulate(job, cache);
+        } else {
+            result = {0, 0, 0, 0.0, false, 0.0, "malformed job"};
+        }
+        if (!Sweep_Send(fd, result.Encode())) break;
+    }
+    delete cache;
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,57 @@
+// Wire protocol between sim-coordinator and `sim --worker=<address>` processes.
+// Every message is a 4-byte little-endian payload length followed by one line of text:
+//   worker -> coordinator  HELLO <pid>
+//   coordinator -> worker  JOB <id> <rob> <iq> <width> <trace path>
+//   worker -> coordinator  RESULT <id> <instructions> <cycles> <ipc> <stalled> <seconds>
+//                          ERROR <id> <message>
+//   coordinator -> worker  QUIT
+// Addresses are "unix:<path>" or "<host>:<port>". Trace paths must name the same file on both ends.
+
+#ifndef ECE463_PROJ3_SWEEP_H
+#define ECE463_PROJ3_SWEEP_H
+#include <cstdint>
+#include <string>
+
+#define SWEEP_MAX_MESSAGE (1 << 16)
+#define SWEEP_STEP_CYCLES (1 << 16)
+#define SWEEP_STALL_CYCLES (1 << 20) // no retirement for this long counts as a hung simulation
+
+struct SweepJob {
+    uint64_t id;
+    int rob_size, iq_size, width;
+    std::string trace;
+
+    [[nodiscard]] std::string Encode() const;
+    static bool Decode(const std::string &message, SweepJob &job);
+    // Same bounds sim applies to its command line
+    [[nodiscard]] bool Valid() const;
+};
+
+struct SweepResult {
+    uint64_t id;
+    uint64_t instructions, cycles;
+    double ipc;
+    bool stalled;
+    double seconds;
+    std::string error; // set for ERROR replies, the counts are then meaningless
+
+    [[nodiscard]] std::string Encode() const;
+    static bool Decode(const std::string &message, SweepResult &result);
+};
+
+// Returns a listening socket, or -1 with the reason printed to stderr
+int Sweep_Listen(const char *address);
+// Returns a connected socket, or -1
+int Sweep_Connect(const char *address);
+
+// Blocking whole-message send and receive, false once the peer is gone
+bool Sweep_Send(int fd, const std::string &message);
+bool Sweep_Receive(int fd, std::string &message);
+// For nonblocking readers: moves the first complete message out of buffer, if there is one.
+// Returns -1 for a frame over SWEEP_MAX_MESSAGE.
+int Sweep_Extract(std::string &buffer, std::string &message);
+
+// Worker loop behind `sim --worker`: connects, simulates jobs until QUIT or the coordinator goes away
+int Sweep_Worker(const char *address);
+
+#endif //ECE463_PROJ3_SWEEP_H
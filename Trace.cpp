@@ -0,0 +1,123 @@
+#include "Trace.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+FileTraceSource::FileTraceSource(const char *path) : m_file(fopen(path, "r")), m_done(false), m_size(0) {
+    if (!m_file) {
+        printf("ERROR: Failed to open tracefile\n");
+        m_done = true;
+        return;
+    }
+    if (fseek(m_file, 0, SEEK_END) == 0) m_size = ftell(m_file);
+    rewind(m_file);
+}
+
+FileTraceSource::~FileTraceSource() {
+    if (m_file) fclose(m_file);
+}
+
+bool FileTraceSource::Next(TraceRecord &record) {
+    if (m_done) return false;
+    unsigned long long pc;
+    if (fscanf(m_file, "%llx %d %d %d %d", &pc, &record.optype, &record.dst, &record.src1, &record.src2) != 5) {
+        fclose(m_file);
+        m_file = nullptr;
+        m_done = true;
+        return false;
+    }
+    record.pc = pc;
+    return true;
+}
+
+double FileTraceSource::Progress() const {
+    if (m_done) return 1.0;
+    if (m_size <= 0) return -1.0;
+    return static_cast<double>(ftell(m_file)) / m_size;
+}
+
+
+void MemoryTraceSource::Feed(const TraceRecord *records, size_t count) {
+    if (m_closed) {
+        printf("ERROR: Feeding a closed trace\n");
+        return;
+    }
+    if (m_position > m_records.size() / 2) { // drop the consumed front before growing
+        m_records.erase(m_records.begin(), m_records.begin() + m_position);
+        m_position = 0;
+    }
+    m_records.insert(m_records.end(), records, records + count);
+    m_fed += count;
+}
+
+bool MemoryTraceSource::Next(TraceRecord &record) {
+    if (m_position == m_records.size()) {
+        m_done = m_closed; // an open source may still be fed more
+        return false;
+    }
+    record = m_records[m_position++];
+    m_consumed++;
+    return true;
+}
+
+bool Trace_HashFile(const char *path, uint64_t *content_hash) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return false;
+    uint64_t hash = Trace_Hash(nullptr, 0);
+    char chunk[1 << 16];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        hash = Trace_Hash(chunk, n, hash);
+    }
+    bool ok = !ferror(file);
+    fclose(file);
+    *content_hash = hash;
+    return ok;
+}
+
+int64_t Trace_Decode(const char *path, TraceRecord **records, uint64_t *content_hash) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        printf("ERROR: Failed to open tracefile\n");
+        return -1;
+    }
+    std::vector<char> text;
+    char chunk[1 << 16];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        text.insert(text.end(), chunk, chunk + n);
+    }
+    fclose(file);
+    *content_hash = Trace_Hash(text.data(), text.size());
+    text.push_back('\0');
+
+    std::vector<TraceRecord> decoded;
+    char *cursor = text.data();
+    while (true) {
+        TraceRecord record;
+        char *end;
+        record.pc = strtoull(cursor, &end, 16);
+        if (end == cursor) break;
+        cursor = end;
+        int32_t *fields[] = {&record.optype, &record.dst, &record.src1, &record.src2};
+        bool complete = true;
+        for (auto field : fields) {
+            *field = static_cast<int32_t>(strtol(cursor, &end, 10));
+            if (end == cursor) {
+                complete = false;
+                break;
+            }
+            cursor = end;
+        }
+        if (!complete) {
+            printf("ERROR: Malformed trace line %zu\n", decoded.size());
+            break;
+        }
+        decoded.push_back(record);
+    }
+
+    *records = new TraceRecord[decoded.size()];
+    std::copy(decoded.begin(), decoded.end(), *records);
+    return static_cast<int64_t>(decoded.size());
+}
@@ -0,0 +1,85 @@
+#ifndef ECE463_PROJ3_TRACE_H
+#define ECE463_PROJ3_TRACE_H
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// One decoded line of a trace file: "<pc> <optype> <dst> <src1> <src2>"
+struct TraceRecord {
+    uint64_t pc;
+    int32_t optype;
+    int32_t dst, src1, src2;
+};
+
+// Where Fetch() pulls instructions from.
+class TraceSource {
+public:
+    virtual ~TraceSource() = default;
+
+    // Fills record with the next instruction, returns false once the trace is exhausted
+    virtual bool Next(TraceRecord &record) = 0;
+    // True once a Next() has come back empty, not as soon as the last record is read.
+    // Fetch() ends the run on it, so every source must agree with the file source here.
+    [[nodiscard]] virtual bool Done() const = 0;
+    // Fraction of the trace consumed so far, negative when the total is unknown
+    [[nodiscard]] virtual double Progress() const {return -1.0;}
+};
+
+// Parses the text trace with fscanf, one record per call
+class FileTraceSource : public TraceSource {
+    FILE *m_file;
+    bool m_done;
+    long m_size;
+public:
+    explicit FileTraceSource(const char *path);
+    ~FileTraceSource() override;
+
+    [[nodiscard]] bool IsOpen() const {return m_file != nullptr;}
+    bool Next(TraceRecord &record) override;
+    [[nodiscard]] bool Done() const override {return m_done;}
+    // Read offset over file size
+    [[nodiscard]] double Progress() const override;
+};
+
+// Records handed over from memory in batches, for embedding the simulator
+class MemoryTraceSource : public TraceSource {
+    std::vector<TraceRecord> m_records;
+    size_t m_position;
+    uint64_t m_fed, m_consumed; // over the whole run, Feed() drops consumed records from m_records
+    bool m_closed;
+    bool m_done;
+public:
+    MemoryTraceSource() : m_position(0), m_fed(0), m_consumed(0), m_closed(false), m_done(false) {}
+
+    void Feed(const TraceRecord *records, size_t count);
+    // No more records will be fed, Done() once a Next() finds the remaining ones consumed
+    void Close() {m_closed = true;}
+
+    bool Next(TraceRecord &record) override;
+    [[nodiscard]] bool Done() const override {return m_done;}
+    [[nodiscard]] size_t Pending() const {return m_records.size() - m_position;}
+    // Only known once closed
+    [[nodiscard]] double Progress() const override {
+        if (!m_closed) return -1.0;
+        return m_fed ? static_cast<double>(m_consumed) / m_fed : 1.0;
+    }
+};
+
+// Reads the whole trace into a newly allocated array, returns the record count or -1 on error.
+// The 64-bit FNV-1a hash of the raw trace text is stored in content_hash.
+int64_t Trace_Decode(const char *path, TraceRecord **records, uint64_t *content_hash);
+
+// Hashes a file's bytes with Trace_Hash(), returns false if it cannot be read
+bool Trace_HashFile(const char *path, uint64_t *content_hash);
+
+// FNV-1a, used for trace content hashes
+inline uint64_t Trace_Hash(const void *data, size_t length, uint64_t hash = 0xcbf29ce484222325ull) {
+    auto bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+#endif //ECE463_PROJ3_TRACE_H
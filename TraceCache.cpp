@@ -0,0 +1,172 @@
+#include "TraceCache.h"
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Builds <dir>/sim-trace-<key>, key covers the trace's path, size and mtime so an edited trace gets a new entry
+static bool CachePath(const char *tracefile, const char *dir, char *path, size_t length, struct stat *source) {
+    char resolved[PATH_MAX];
+    if (!realpath(tracefile, resolved) || stat(resolved, source) != 0) {
+        printf("ERROR: Failed to stat tracefile\n");
+        return false;
+    }
+    int64_t mtime_ns = static_cast<int64_t>(source->st_mtim.tv_sec) * 1000000000 + source->st_mtim.tv_nsec;
+    uint64_t key = Trace_Hash(resolved, strlen(resolved));
+    key = Trace_Hash(&source->st_size, sizeof(source->st_size), key);
+    key = Trace_Hash(&mtime_ns, sizeof(mtime_ns), key);
+    snprintf(path, length, "%s/sim-trace-%016llx", dir, static_cast<unsigned long long>(key));
+    return true;
+}
+
+// content_hash catches a trace rewritten in place with the same size and mtime
+static bool HeaderValid(const TraceCacheHeader *header, size_t map_length, const struct stat &source,
+                        uint64_t content_hash) {
+    int64_t mtime_ns = static_cast<int64_t>(source.st_mtim.tv_sec) * 1000000000 + source.st_mtim.tv_nsec;
+    return header->magic == TRACE_CACHE_MAGIC
+        && header->version == TRACE_CACHE_VERSION
+        && header->record_size == sizeof(TraceRecord)
+        && map_length == sizeof(TraceCacheHeader) + header->record_count * sizeof(TraceRecord)
+        && header->source_size == static_cast<uint64_t>(source.st_size)
+        && header->source_mtime_ns == mtime_ns
+        && header->content_hash == content_hash;
+}
+
+// Maps an existing entry read-only, returns nullptr (and closes the file) if it is missing or stale
+SharedTraceSource *SharedTraceSource::Attach(const char *path, const struct stat &source, uint64_t content_hash) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return nullptr;
+    flock(fd, LOCK_SH); // blocks only while Remove() is unlinking this entry, the mapping stays valid after that
+    struct stat cache;
+    if (fstat(fd, &cache) != 0 || static_cast<size_t>(cache.st_size) < sizeof(TraceCacheHeader)) {
+        close(fd);
+        return nullptr;
+    }
+    size_t length = cache.st_size;
+    void *map = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return nullptr;
+    }
+    if (!HeaderValid(static_cast<const TraceCacheHeader*>(map), length, source, content_hash)) {
+        munmap(map, length);
+        close(fd);
+        return nullptr;
+    }
+    return new SharedTraceSource(fd, map, length);
+}
+
+// Decodes the trace into a private temp file and renames it into place, so readers only ever see complete entries
+static bool Create(const char *tracefile, const char *path, const struct stat &source) {
+    TraceRecord *records;
+    TraceCacheHeader header{};
+    int64_t count = Trace_Decode(tracefile, &records, &header.content_hash);
+    if (count < 0) return false;
+    header.magic = TRACE_CACHE_MAGIC;
+    header.version = TRACE_CACHE_VERSION;
+    header.record_size = sizeof(TraceRecord);
+    header.record_count = count;
+    header.source_size = source.st_size;
+    header.source_mtime_ns = static_cast<int64_t>(source.st_mtim.tv_sec) * 1000000000 + source.st_mtim.tv_nsec;
+
+    std::string temp = std::string(path) + "." + std::to_string(getpid()) + ".tmp";
+    int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        printf("ERROR: Failed to create trace cache %s\n", temp.c_str());
+        delete[] records;
+        return false;
+    }
+    bool ok = write(fd, &header, sizeof(header)) == sizeof(header);
+    size_t remaining = count * sizeof(TraceRecord);
+    auto bytes = reinterpret_cast<const char*>(records);
+    while (ok && remaining > 0) {
+        ssize_t written = write(fd, bytes, remaining);
+        ok = written > 0;
+        if (ok) {
+            bytes += written;
+            remaining -= written;
+        }
+    }
+    close(fd);
+    delete[] records;
+    if (!ok || rename(temp.c_str(), path) != 0) {
+        printf("ERROR: Failed to write trace cache %s\n", path);
+        unlink(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+SharedTraceSource::SharedTraceSource(int fd, void *map, size_t map_length)
+    :   m_fd(fd),
+        m_map(map),
+        m_map_length(map_length),
+        m_header(static_cast<const TraceCacheHeader*>(map)),
+        m_records(reinterpret_cast<const TraceRecord*>(static_cast<const char*>(map) + sizeof(TraceCacheHeader))),
+        m_position(0),
+        m_done(false) {
+}
+
+SharedTraceSource::~SharedTraceSource() {
+    munmap(m_map, m_map_length);
+    close(m_fd); // drops the shared flock
+}
+
+SharedTraceSource *SharedTraceSource::Open(const char *tracefile, const char *dir) {
+    char path[PATH_MAX];
+    struct stat source;
+    if (!CachePath(tracefile, dir, path, sizeof(path), &source)) return nullptr;
+    // hashing the text is a plain read, still far cheaper than decoding it
+    uint64_t content_hash;
+    if (!Trace_HashFile(tracefile, &content_hash)) return nullptr;
+
+    if (auto attached = Attach(path, source, content_hash)) return attached;
+
+    // Only one process decodes, the rest wait on the lock and then attach to its result.
+    // The lock only saves duplicate work: Create() is atomic, so losing the lock file to Remove() is harmless.
+    char lock_path[PATH_MAX + 8];
+    snprintf(lock_path, sizeof(lock_path), "%s.lock", path);
+    int lock = open(lock_path, O_RDWR | O_CREAT, 0644);
+    if (lock >= 0) flock(lock, LOCK_EX);
+    SharedTraceSource *attached = Attach(path, source, content_hash);
+    if (!attached && Create(tracefile, path, source)) {
+        attached = Attach(path, source, content_hash);
+    }
+    if (lock >= 0) close(lock);
+    if (!attached) printf("ERROR: Failed to attach trace cache %s\n", path);
+    return attached;
+}
+
+bool SharedTraceSource::Remove(const char *tracefile, const char *dir) {
+    char path[PATH_MAX];
+    struct stat source;
+    if (!CachePath(tracefile, dir, path, sizeof(path), &source)) return false;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    bool removed = false;
+    if (flock(fd, LOCK_EX | LOCK_NB) == 0) { // fails while any process is attached
+        removed = unlink(path) == 0;
+        char lock_path[PATH_MAX + 8];
+        snprintf(lock_path, sizeof(lock_path), "%s.lock", path);
+        unlink(lock_path);
+    }
+    close(fd);
+    return removed;
+}
+
+bool SharedTraceSource::Next(TraceRecord &record) {
+    if (m_position == m_header->record_count) {
+        m_done = true;
+        return false;
+    }
+    record = m_records[m_position++];
+    return true;
+}
@@ -0,0 +1,58 @@
+#ifndef ECE463_PROJ3_TRACECACHE_H
+#define ECE463_PROJ3_TRACECACHE_H
+#include <cstdint>
+
+#include "Trace.h"
+
+struct stat;
+
+#define TRACE_CACHE_MAGIC 0x4543415254534d53ull // "SMSTRACE"
+#define TRACE_CACHE_VERSION 1
+#define TRACE_CACHE_DIR "/dev/shm"
+
+// Layout of a cache file: this header followed by record_count TraceRecords
+struct TraceCacheHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t record_count;
+    uint64_t content_hash;   // FNV-1a of the trace text
+    uint64_t source_size;    // size and mtime of the trace when it was decoded
+    int64_t source_mtime_ns;
+};
+
+// Decoded trace shared between every sim process on the node.
+// The first process decodes the trace into <dir>/sim-trace-<key>, later ones map it read-only
+// once its size, mtime and content hash match the trace on disk.
+// Each attached process holds a shared flock on the file so Remove() never pulls it out from under a reader.
+class SharedTraceSource : public TraceSource {
+    int m_fd;
+    void *m_map;
+    size_t m_map_length;
+    const TraceCacheHeader *m_header;
+    const TraceRecord *m_records;
+    uint64_t m_position;
+    bool m_done;
+
+    SharedTraceSource(int fd, void *map, size_t map_length);
+    static SharedTraceSource *Attach(const char *path, const struct stat &source, uint64_t content_hash);
+public:
+    ~SharedTraceSource() override;
+
+    // Attaches to (creating if needed) the cache entry for tracefile, returns nullptr on failure
+    static SharedTraceSource *Open(const char *tracefile, const char *dir = TRACE_CACHE_DIR);
+
+    // Unlinks the cache entry for tracefile if no process is attached to it, returns true if removed
+    static bool Remove(const char *tracefile, const char *dir = TRACE_CACHE_DIR);
+
+    bool Next(TraceRecord &record) override;
+    [[nodiscard]] bool Done() const override {return m_done;}
+    [[nodiscard]] double Progress() const override {
+        return m_header->record_count ? static_cast<double>(m_position) / m_header->record_count : 1.0;
+    }
+
+    [[nodiscard]] const TraceCacheHeader &Header() const {return *m_header;}
+    [[nodiscard]] const TraceRecord *Records() const {return m_records;}
+};
+
+#endif //ECE463_PROJ3_TRACECACHE_H
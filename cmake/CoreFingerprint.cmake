@@ -0,0 +1,11 @@
+# Writes OUTPUT defining RESULTS_CORE_FINGERPRINT, a hash of the '|'-separated SOURCES.
+# Run at build time for core_fingerprint.h, the Makefile does the same with cksum.
+string(REPLACE "|" ";" SOURCES "${SOURCES}")
+set(hashes "")
+foreach(source IN LISTS SOURCES)
+    file(SHA256 ${source} hash)
+    string(APPEND hashes ${hash})
+endforeach()
+string(SHA256 hash "${hashes}")
+string(SUBSTRING ${hash} 0 8 hash)
+file(WRITE ${OUTPUT} "#define RESULTS_CORE_FINGERPRINT 0x${hash}u\n")
@@ -0,0 +1,70 @@
+#include "libsim.h"
+
+#include <cstddef>
+
+#include "Simulator.h"
+
+static_assert(sizeof(sim_trace_record) == sizeof(TraceRecord), "sim_trace_record must match TraceRecord");
+static_assert(offsetof(sim_trace_record, src2) == offsetof(TraceRecord, src2), "sim_trace_record must match TraceRecord");
+static_assert(sizeof(sim_timing_record) == sizeof(TimingRecord), "sim_timing_record must match TimingRecord");
+static_assert(offsetof(sim_timing_record, rt_length) == offsetof(TimingRecord, rt_length), "sim_timing_record must match TimingRecord");
+
+struct sim_simulator {
+    Simulator simulator;
+    sim_retire_callback callback;
+    void *user;
+
+    explicit sim_simulator(const SimConfig &config) : simulator(config), callback(nullptr), user(nullptr) {}
+};
+
+static void Forward(const TimingRecord *records, size_t count, void *user) {
+    auto sim = static_cast<sim_simulator*>(user);
+    sim->callback(reinterpret_cast<const sim_timing_record*>(records), count, sim->user);
+}
+
+extern "C" {
+
+sim_simulator *sim_create(const sim_config *config) {
+    return new sim_simulator({config->rob_size, config->iq_size, config->width});
+}
+
+void sim_destroy(sim_simulator *sim) {
+    delete sim;
+}
+
+void sim_feed(sim_simulator *sim, const sim_trace_record *records, size_t count) {
+    sim->simulator.Feed(reinterpret_cast<const TraceRecord*>(records), count);
+}
+
+void sim_close_input(sim_simulator *sim) {
+    sim->simulator.CloseInput();
+}
+
+void sim_set_retire_callback(sim_simulator *sim, sim_retire_callback callback, void *user) {
+    sim->callback = callback;
+    sim->user = user;
+    sim->simulator.SetRetireCallback(callback ? Forward : nullptr, sim);
+}
+
+uint64_t sim_step(sim_simulator *sim, uint64_t cycles) {
+    return sim->simulator.Step(cycles);
+}
+
+void sim_run(sim_simulator *sim) {
+    sim->simulator.CloseInput();
+    sim->simulator.Run();
+}
+
+int sim_done(const sim_simulator *sim) {
+    return sim->simulator.Done();
+}
+
+uint64_t sim_cycles(const sim_simulator *sim) {
+    return sim->simulator.GetCycleCount();
+}
+
+uint64_t sim_retired(const sim_simulator *sim) {
+    return sim->simulator.GetRetiredCount();
+}
+
+}
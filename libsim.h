@@ -0,0 +1,75 @@
+/*
+ * Plain C interface to the simulator, for tools that embed libsim instead of running sim.
+ * C++ callers can use Simulator directly with a SimConfig.
+ */
+
+#ifndef ECE463_PROJ3_LIBSIM_H
+#define ECE463_PROJ3_LIBSIM_H
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct sim_simulator sim_simulator;
+
+typedef struct {
+    int rob_size;
+    int iq_size;
+    int width;
+} sim_config;
+
+/* One trace line, same layout as TraceRecord */
+typedef struct {
+    uint64_t pc;
+    int32_t optype;
+    int32_t dst, src1, src2;
+} sim_trace_record;
+
+/* Timing of one retired instruction, same layout as TimingRecord */
+typedef struct {
+    uint64_t trace_line;
+    int optype;
+    int src1, src2, dst;
+    uint32_t fe_begin, fe_length;
+    uint32_t de_begin, de_length;
+    uint32_t rn_begin, rn_length;
+    uint32_t rr_begin, rr_length;
+    uint32_t di_begin, di_length;
+    uint32_t iq_begin, iq_length;
+    uint32_t ex_begin, ex_length;
+    uint32_t wb_begin, wb_length;
+    uint32_t rt_begin, rt_length;
+} sim_timing_record;
+
+/* Called once per cycle with the instructions retired that cycle, records are only valid during the call */
+typedef void (*sim_retire_callback)(const sim_timing_record *records, size_t count, void *user);
+
+sim_simulator *sim_create(const sim_config *config);
+void sim_destroy(sim_simulator *sim);
+
+void sim_feed(sim_simulator *sim, const sim_trace_record *records, size_t count);
+/* No more records will be fed, required before sim_run() */
+void sim_close_input(sim_simulator *sim);
+
+void sim_set_retire_callback(sim_simulator *sim, sim_retire_callback callback, void *user);
+
+/* Runs at most cycles cycles, returns the number run */
+uint64_t sim_step(sim_simulator *sim, uint64_t cycles);
+/*
+ * Closes the input and runs until fetch finds it exhausted, the same cycle a sim run of the same trace ends on.
+ * Like sim, the pipeline is not drained: instructions still in flight then never retire or reach the callback.
+ */
+void sim_run(sim_simulator *sim);
+
+/* Nonzero once the input is closed and exhausted, see sim_run() */
+int sim_done(const sim_simulator *sim);
+uint64_t sim_cycles(const sim_simulator *sim);
+uint64_t sim_retired(const sim_simulator *sim);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ECE463_PROJ3_LIBSIM_H */
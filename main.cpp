@@ -1,18 +1,184 @@
 #include <iostream>
+#include <cstring>
 
+#include "AsyncIO.h"
+#include "Heartbeat.h"
+#include "Instrumentation.h"
+#include "Memo.h"
+#include "ResultsCache.h"
 #include "Simulator.h"
+#include "Sweep.h"
+#include "TraceCache.h"
+
+static const char *instrumentation_names[] = {"none", "counters", "cycles", "latches", "events"};
+
+static bool Known_Instrumentation(const char *name) {
+    for (auto known : instrumentation_names) {
+        if (!strcmp(name, known)) return true;
+    }
+    return false;
+}
+
+// Runs with the instrumentation policy named on the command line, which main() has checked is one of
+// instrumentation_names. The counters report goes to report.
+static void Run_Instrumented(Simulator &simulator, const char *name, FILE *report) {
+    if (!strcmp(name, "none")) {
+        simulator.Run();
+    } else if (!strcmp(name, "counters")) {
+        CounterInstrumentation counters(report);
+        simulator.Run(counters);
+    } else if (!strcmp(name, "cycles")) {
+        CycleDumpInstrumentation dump(stderr);
+        simulator.Run(dump);
+    } else if (!strcmp(name, "latches")) {
+        LatchLogInstrumentation latches("debug");
+        simulator.Run(latches);
+    } else if (!strcmp(name, "events")) {
+        EventTraceInstrumentation events(stderr);
+        simulator.Run(events);
+    }
+}
 
 int main(int argc, char **argv) {
-    if (argc != 5) {
-        printf("Usage: sim <ROB_SIZE> <IQ_SIZE> <WIDTH> <tracefile>");
+    // Worker for sim-coordinator, jobs arrive over the socket instead of the command line
+    if (argc == 2 && !strncmp(argv[1], "--worker=", 9)) return Sweep_Worker(argv[1] + 9);
+
+    if (argc < 5) {
+        printf("Usage: sim <ROB_SIZE> <IQ_SIZE> <WIDTH> <tracefile> [--shm-trace] [--shm-trace-clean] [--async-io] [--cache|--no-cache|--refresh]"
+               " [--heartbeat=<seconds>] [--heartbeat-instr=<millions>] [--heartbeat-file=<path>]"
+               " [--instrument=none|counters|cycles|latches|events] [--memoize]\n"
+               "       sim --worker=<unix:path|host:port>\n");
+        return 1;
     }
     auto rob_size = atoi(argv[1]);
     auto iq_size = atoi(argv[2]);
     auto width = atoi(argv[3]);
     char *tracefile = argv[4];
+    if (!SimConfig{rob_size, iq_size, width}.Valid()) {
+        printf("ERROR: ROB_SIZE, IQ_SIZE and WIDTH must be between 1 and %d\n", SIM_MAX_CONFIG);
+        return 1;
+    }
 
-    Simulator simulator(rob_size,iq_size,width,tracefile);
-    simulator.Run();
+    bool shm_trace = false, shm_trace_clean = false, async_io = false;
+    bool cache = getenv("SIM_CACHE_DIR") != nullptr, refresh = false;
+    double heartbeat_seconds = 0;
+    uint64_t heartbeat_instructions = 0;
+    const char *heartbeat_file = nullptr;
+    const char *instrument = "none";
+    bool memoize = false;
+    for (int i = 5; i < argc; i++) {
+        if (!strcmp(argv[i], "--shm-trace")) shm_trace = true;
+        else if (!strcmp(argv[i], "--shm-trace-clean")) shm_trace = shm_trace_clean = true;
+        else if (!strcmp(argv[i], "--async-io")) async_io = true;
+        else if (!strcmp(argv[i], "--cache")) cache = true;
+        else if (!strcmp(argv[i], "--no-cache")) cache = false;
+        else if (!strcmp(argv[i], "--refresh")) cache = refresh = true;
+        else if (!strncmp(argv[i], "--heartbeat=", 12)) heartbeat_seconds = atof(argv[i] + 12);
+        else if (!strncmp(argv[i], "--heartbeat-instr=", 18)) heartbeat_instructions = atof(argv[i] + 18) * 1e6;
+        else if (!strncmp(argv[i], "--heartbeat-file=", 17)) heartbeat_file = argv[i] + 17;
+        else if (!strncmp(argv[i], "--instrument=", 13)) {
+            instrument = argv[i] + 13;
+            if (!Known_Instrumentation(instrument)) {
+                printf("ERROR: Unknown instrumentation %s\n", instrument);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "--memoize")) memoize = true;
+        else {
+            printf("ERROR: Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    // Replayed iterations bypass the instrumentation hooks
+    if (memoize && strcmp(instrument, "none")) {
+        printf("ERROR: --memoize cannot be combined with --instrument=%s\n", instrument);
+        return 1;
+    }
+
+    TraceSource *trace = nullptr;
+    if (shm_trace) trace = SharedTraceSource::Open(tracefile);
+    if (!trace) trace = new FileTraceSource(tracefile); // fall back to parsing privately
+
+    // A hit skips the simulation entirely, so only the results summary is printed.
+    // With caching on the summary follows the timing log on a miss too, so both runs end the same way.
+    // The counters report is the entry's stats blob, an entry stored without one cannot answer a counters run.
+    bool counters = !strcmp(instrument, "counters");
+    ResultsCache *results_cache = nullptr;
+    ResultsKey key{0, rob_size, iq_size, width};
+    if (cache) {
+        auto shared = dynamic_cast<SharedTraceSource*>(trace);
+        if (shared) key.trace_hash = shared->Header().content_hash;
+        if (shared || Trace_HashFile(tracefile, &key.trace_hash)) {
+            auto max_bytes = getenv("SIM_CACHE_MAX_BYTES");
+            results_cache = new ResultsCache(ResultsCache::DefaultDir(),
+                max_bytes ? strtoull(max_bytes, nullptr, 10) : RESULTS_CACHE_MAX_BYTES);
+            SimResult result;
+            if (!refresh && results_cache->Lookup(key, result) && (!counters || !result.stats.empty())) {
+                result.Print();
+                if (counters) fputs(result.stats.c_str(), stderr);
+                delete results_cache;
+                delete trace;
+                return 0;
+            }
+        }
+    }
+
+    AsyncTraceSource *reader = nullptr;
+    TimingWriter *writer = nullptr;
+    if (async_io) {
+        trace = reader = new AsyncTraceSource(trace);
+        writer = new TimingWriter(stdout);
+    }
+
+    // Progress goes to stderr (or a side file) so stdout stays the timing log.
+    // Always attached so SIGUSR1 gets a snapshot even without periodic reports.
+    FILE *heartbeat_out = stderr;
+    if (heartbeat_file && !(heartbeat_out = fopen(heartbeat_file, "w"))) {
+        fprintf(stderr, "Cannot create `%s', heartbeat goes to stderr\n", heartbeat_file);
+        heartbeat_out = stderr;
+    }
+    Heartbeat heartbeat(heartbeat_seconds, heartbeat_instructions, heartbeat_out);
+    Heartbeat::InstallSignalHandler();
+
+    // Counters are collected in memory when they have to go into the cache as well
+    char *stats = nullptr;
+    size_t stats_length = 0;
+    FILE *report = results_cache && counters ? open_memstream(&stats, &stats_length) : nullptr;
+
+    {
+        Simulator simulator(rob_size,iq_size,width,trace);
+        simulator.SetTimingWriter(writer);
+        simulator.SetHeartbeat(&heartbeat);
+        LoopMemo *memo = memoize ? new LoopMemo() : nullptr;
+        simulator.SetMemo(memo);
+        Run_Instrumented(simulator, instrument, report ? report : stderr);
+        if (heartbeat_seconds > 0 || heartbeat_instructions) heartbeat.Report(simulator);
+        if (memo) {
+            memo->Print(simulator.GetCycleCount(), stderr);
+            delete memo;
+        }
+        SimResult result{simulator.GetRetiredCount(), simulator.GetCycleCount(), 0.0};
+        if (result.cycles) result.ipc = static_cast<double>(result.instructions) / result.cycles;
+        if (report) {
+            fclose(report);
+            fputs(stats, stderr);
+            result.stats.assign(stats, stats_length);
+            free(stats);
+        }
+        if (async_io) {
+            writer->Finish();
+            reader->Wait().Print("trace ring");
+            writer->Wait().Print("timing ring");
+            delete writer;
+        }
+        if (cache) result.Print();
+        if (results_cache) {
+            results_cache->Store(key, result);
+            delete results_cache;
+        }
+    }
+    if (heartbeat_out != stderr) fclose(heartbeat_out);
+    if (shm_trace_clean) SharedTraceSource::Remove(tracefile); // no-op while other processes are still attached
 
     return 0;
 }
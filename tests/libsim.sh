@@ -0,0 +1,41 @@
+#!/bin/sh
+# A trace fed through the C API must end on the same cycle, with the same retire count, as a sim run.
+# libsim_test itself checks the retire callback order and count. Only prefixes long enough to get
+# instructions through to retire before fetch runs dry exercise those, and they must retire some.
+# Usage: libsim.sh <sim> <libsim_test> <tracefile>
+
+SIM=${1:-./sim}
+LIBSIM_TEST=${2:-tests/libsim_test}
+TRACE=${3:-proj3-traces/val_trace_gcc1}
+WORK=$(mktemp -d) || exit 1
+trap 'rm -rf "$WORK"' EXIT
+failed=0
+
+# --refresh always simulates and prints the results summary
+export SIM_CACHE_DIR="$WORK/cache"
+
+for length in 1 5 16 1000 1001 1002 1003 all; do
+    if [ $length = all ]; then
+        cp "$TRACE" "$WORK/trace"
+    else
+        head -n $length "$TRACE" > "$WORK/trace"
+    fi
+    for width in 1 2 3 4 8; do
+        timeout 60 "$SIM" 64 32 $width "$WORK/trace" --refresh 2>/dev/null | grep '^# ' > "$WORK/sim"
+        if ! timeout 60 "$LIBSIM_TEST" 64 32 $width "$WORK/trace" > "$WORK/libsim"; then
+            echo "FAIL: $length records, width $width: libsim_test failed"
+            failed=1
+        elif ! cmp -s "$WORK/sim" "$WORK/libsim"; then
+            echo "FAIL: $length records, width $width: libsim results differ from sim"
+            diff "$WORK/sim" "$WORK/libsim"
+            failed=1
+        elif { [ $length = all ] || [ $length -ge 1000 ]; } \
+                && grep -q '^# Dynamic Instruction Count *= *0$' "$WORK/libsim"; then
+            echo "FAIL: $length records, width $width: nothing retired"
+            failed=1
+        fi
+    done
+done
+
+[ $failed = 0 ] && echo "libsim: all results match sim"
+exit $failed
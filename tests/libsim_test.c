@@ -0,0 +1,88 @@
+/*
+ * C caller of libsim.h: feeds a trace file through the C API and prints the same results summary as
+ * `sim --cache`, so tests/libsim.sh can hold the two to each other. Also checks the retire callback
+ * sees every retired instruction once, in program order.
+ * Usage: libsim_test <ROB_SIZE> <IQ_SIZE> <WIDTH> <tracefile>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../libsim.h"
+
+#define FEED_BATCH 1024
+
+struct retire_check {
+    uint64_t retired;
+    uint64_t next_line;
+    int out_of_order;
+};
+
+static void on_retire(const sim_timing_record *records, size_t count, void *user) {
+    struct retire_check *check = user;
+    size_t i;
+    for (i = 0; i < count; i++) {
+        if (records[i].trace_line != check->next_line) check->out_of_order = 1;
+        check->next_line = records[i].trace_line + 1;
+    }
+    check->retired += count;
+}
+
+int main(int argc, char **argv) {
+    sim_config config;
+    sim_simulator *sim;
+    sim_trace_record batch[FEED_BATCH];
+    struct retire_check check = {0, 0, 0};
+    unsigned long long pc;
+    size_t count = 0;
+    FILE *trace;
+    int failed = 0;
+
+    if (argc != 5) {
+        fprintf(stderr, "Usage: libsim_test <ROB_SIZE> <IQ_SIZE> <WIDTH> <tracefile>\n");
+        return 1;
+    }
+    config.rob_size = atoi(argv[1]);
+    config.iq_size = atoi(argv[2]);
+    config.width = atoi(argv[3]);
+    if (!(trace = fopen(argv[4], "r"))) {
+        fprintf(stderr, "Cannot read trace `%s'\n", argv[4]);
+        return 1;
+    }
+
+    sim = sim_create(&config);
+    sim_set_retire_callback(sim, on_retire, &check);
+    while (fscanf(trace, "%llx %d %d %d %d", &pc, &batch[count].optype, &batch[count].dst,
+                  &batch[count].src1, &batch[count].src2) == 5) {
+        batch[count].pc = pc;
+        if (++count == FEED_BATCH) {
+            sim_feed(sim, batch, count);
+            count = 0;
+        }
+    }
+    sim_feed(sim, batch, count);
+    fclose(trace);
+    sim_run(sim);
+
+    if (!sim_done(sim)) {
+        fprintf(stderr, "FAIL: sim_run() returned before the simulation was done\n");
+        failed = 1;
+    }
+    if (check.retired != sim_retired(sim)) {
+        fprintf(stderr, "FAIL: callback saw %llu instructions, sim_retired() says %llu\n",
+            (unsigned long long)check.retired, (unsigned long long)sim_retired(sim));
+        failed = 1;
+    }
+    if (check.out_of_order) {
+        fprintf(stderr, "FAIL: instructions retired out of program order\n");
+        failed = 1;
+    }
+
+    printf("# === Simulation Results ========\n");
+    printf("# Dynamic Instruction Count    = %llu\n", (unsigned long long)sim_retired(sim));
+    printf("# Cycles                       = %llu\n", (unsigned long long)sim_cycles(sim));
+    printf("# Instructions Per Cycle (IPC) = %.2f\n",
+        sim_cycles(sim) ? (double)sim_retired(sim) / sim_cycles(sim) : 0.0);
+    sim_destroy(sim);
+    return failed;
+}
@@ -0,0 +1,78 @@
+#!/bin/sh
+# The results cache must answer a repeated run with the summary of the run that stored it, and only that run:
+# a miss simulates and stores, a hit prints the stored summary without the timing log, --refresh and a
+# changed config or trace simulate again, and the stored counters report comes back on a counters hit.
+# Also fills a small cache past SIM_CACHE_MAX_BYTES to check the periodic eviction.
+# Usage: results_cache.sh <sim> <tracefile>
+
+SIM=${1:-./sim}
+TRACE=${2:-proj3-traces/val_trace_gcc1}
+WORK=$(mktemp -d) || exit 1
+trap 'rm -rf "$WORK"' EXIT
+failed=0
+
+export SIM_CACHE_DIR="$WORK/cache"
+head -n 1000 "$TRACE" > "$WORK/trace"
+
+fail() {
+    echo "FAIL: $*"
+    failed=1
+}
+
+entries() {
+    ls "$SIM_CACHE_DIR" | grep -c '\.res$'
+}
+
+# miss: timing log then summary, one entry stored
+"$SIM" 64 32 4 "$WORK/trace" --cache > "$WORK/miss" 2>/dev/null
+grep '^# ' "$WORK/miss" > "$WORK/summary"
+grep -q '^# Dynamic Instruction Count *= *[1-9]' "$WORK/summary" || fail "miss: nothing retired"
+grep -q '^[0-9]' "$WORK/miss" || fail "miss: no timing log"
+[ "$(entries)" = 1 ] || fail "miss: expected 1 entry, found $(entries)"
+
+# hit: the same summary and nothing else
+"$SIM" 64 32 4 "$WORK/trace" --cache > "$WORK/hit" 2>/dev/null
+cmp -s "$WORK/summary" "$WORK/hit" || fail "hit: output is not exactly the stored summary"
+
+# --refresh and --no-cache simulate again, --refresh leaves the one entry in place
+"$SIM" 64 32 4 "$WORK/trace" --refresh > "$WORK/refresh" 2>/dev/null
+cmp -s "$WORK/miss" "$WORK/refresh" || fail "--refresh: output differs from the first run"
+"$SIM" 64 32 4 "$WORK/trace" --no-cache > "$WORK/plain" 2>/dev/null
+grep -q '^# ' "$WORK/plain" && fail "--no-cache: printed a results summary"
+[ "$(entries)" = 1 ] || fail "refresh: expected 1 entry, found $(entries)"
+
+# another config and an edited trace are misses with their own entries
+"$SIM" 64 32 2 "$WORK/trace" --cache > "$WORK/other" 2>/dev/null
+grep -q '^[0-9]' "$WORK/other" || fail "width 2: hit the width 4 entry"
+sed '1s/^\([0-9a-f]*\) [0-9]/\1 2/' "$WORK/trace" > "$WORK/edited"
+"$SIM" 64 32 4 "$WORK/edited" --cache > "$WORK/other" 2>/dev/null
+grep -q '^[0-9]' "$WORK/other" || fail "edited trace: hit the original trace's entry"
+[ "$(entries)" = 3 ] || fail "expected 3 entries, found $(entries)"
+
+# an entry from another core build no longer matches
+for entry in "$SIM_CACHE_DIR"/*.res; do
+    sed -i '1s/ [0-9a-f]*$/ 0/' "$entry"
+done
+"$SIM" 64 32 4 "$WORK/trace" --cache > "$WORK/other" 2>/dev/null
+grep -q '^[0-9]' "$WORK/other" || fail "core fingerprint: hit an entry stored by another core"
+
+# the counters report is stored with the result and replayed on a hit
+rm -rf "$SIM_CACHE_DIR"
+"$SIM" 64 32 4 "$WORK/trace" --cache --instrument=counters 2> "$WORK/counters" > /dev/null
+"$SIM" 64 32 4 "$WORK/trace" --cache --instrument=counters 2> "$WORK/counters_hit" > "$WORK/hit"
+cmp -s "$WORK/summary" "$WORK/hit" || fail "counters: second run was not a hit"
+grep -q '^CM ' "$WORK/counters" || fail "counters: no report on the miss"
+cmp -s "$WORK/counters" "$WORK/counters_hit" || fail "counters: hit did not replay the stored report"
+
+# 64 stores into a cache capped at 2000 bytes trigger one eviction scan
+rm -rf "$SIM_CACHE_DIR"
+head -n 16 "$TRACE" > "$WORK/short"
+for rob in $(seq 1 64); do
+    SIM_CACHE_MAX_BYTES=2000 "$SIM" $rob 8 1 "$WORK/short" --cache > /dev/null 2>&1
+done
+bytes=$(cat "$SIM_CACHE_DIR"/*.res | wc -c)
+[ "$bytes" -le 2000 ] || fail "eviction: $bytes bytes left in a 2000 byte cache after 64 stores"
+[ "$(entries)" -gt 0 ] || fail "eviction: evicted every entry"
+
+[ $failed = 0 ] && echo "results cache: hits and misses as expected"
+exit $failed
@@ -0,0 +1,87 @@
+/*
+ * Drives ReorderBuffer directly against a plain deque model: random pushes, writebacks in any order and
+ * bulk retires of up to a few hundred entries. Covers ROB sizes that are and are not a power of two, up
+ * to past 4096, so retire() walks ready bits across word boundaries and wraps at the end of the store.
+ * Usage: rob_test
+ */
+
+#include <cstdio>
+#include <deque>
+#include <random>
+#include <vector>
+
+#include "../Simulator.h"
+
+struct ModelEntry {
+    Instruction *instr;
+    bool ready;
+};
+
+static int failures = 0;
+
+static void Check(bool ok, size_t rob_size, uint64_t step, const char *what) {
+    if (!ok && failures++ < 10) {
+        fprintf(stderr, "FAIL: ROB %zu, step %llu: %s\n", rob_size, (unsigned long long)step, what);
+    }
+}
+
+// Runs steps random operations, keeping the ROB between empty and full
+static uint64_t Run(size_t rob_size, uint64_t steps, unsigned seed) {
+    std::mt19937 random(seed);
+    std::vector<Instruction> pool(rob_size); // slot i's instruction is pool[i], only the pointers are compared
+    std::vector<Instruction*> retired(rob_size);
+    ReorderBuffer rob(static_cast<int>(rob_size));
+    std::deque<ModelEntry> model;
+    std::deque<size_t> slots; // ROB slot of each model entry
+    size_t next = 0;
+    uint64_t total = 0;
+
+    for (uint64_t step = 0; step < steps && !failures; step++) {
+        // pushes fill the ROB most of the way, then retires drain it, so the head laps the store many times
+        size_t pushes = random() % (rob_size + 1);
+        for (size_t i = 0; i < pushes && !rob.full(); i++) {
+            auto instr = &pool[next++ % rob_size];
+            slots.push_back(rob.push({0, true, false, false, false, 0, instr}));
+            model.push_back({instr, false});
+        }
+        Check(rob.size() == model.size(), rob_size, step, "size() differs from the model after pushing");
+
+        // writeback marks a random subset ready, with long ready runs more likely than not
+        for (size_t i = 0; i < model.size(); i++) {
+            if (!model[i].ready && random() % 4 != 0) {
+                model[i].ready = true;
+                rob.set_ready(slots[i]);
+            }
+        }
+
+        size_t width = 1 + random() % std::min<size_t>(rob_size, 300);
+        size_t count = rob.retire(width, retired.data());
+        size_t expected = 0;
+        while (expected < width && expected < model.size() && model[expected].ready) expected++;
+        Check(count == expected, rob_size, step, "retire() committed a different count than the ready prefix");
+        for (size_t i = 0; i < count && i < expected; i++) {
+            Check(retired[i] == model[i].instr, rob_size, step, "retire() handed back the wrong instruction");
+        }
+        for (size_t i = 0; i < expected; i++) {
+            model.pop_front();
+            slots.pop_front();
+        }
+        total += count;
+    }
+    return total;
+}
+
+int main() {
+    const size_t sizes[] = {1, 2, 3, 32, 63, 64, 65, 100, 128, 511, 1000, 4095, 4096, 4097, 8192, 10000};
+    for (auto size : sizes) {
+        uint64_t retired = Run(size, 2000, static_cast<unsigned>(size));
+        if (failures) break;
+        if (retired == 0) {
+            fprintf(stderr, "FAIL: ROB %zu: nothing retired\n", size);
+            failures++;
+        }
+    }
+    if (failures) return 1;
+    printf("rob: all retires match the model\n");
+    return 0;
+}
@@ -0,0 +1,81 @@
+#!/bin/sh
+# simdiff against a reference file. A reference made by the same sim must compare the same. Edited copies
+# must be reported as DIVERGED, with exit status 1, at the edited line. The copies edit one retire record's RT
+# field, the cycle count in the results summary, and cut off the tail. A simulator that crashes after matching
+# output must be reported as failed with exit status 2.
+# Usage: simdiff.sh <sim> <simdiff> <tracefile>
+
+SIM=${1:-./sim}
+SIMDIFF=${2:-./simdiff}
+TRACE=${3:-proj3-traces/val_trace_gcc1}
+WORK=$(mktemp -d) || exit 1
+trap 'rm -rf "$WORK"' EXIT
+failed=0
+
+fail() {
+    echo "FAIL: $*"
+    failed=1
+}
+
+# --refresh always simulates and prints the results summary, so the cycle count is compared too
+export SIM_CACHE_DIR="$WORK/cache"
+head -n 1000 "$TRACE" > "$WORK/trace"
+"$SIM" 64 32 4 "$WORK/trace" --refresh > "$WORK/reference" 2>/dev/null
+
+# Runs simdiff against reference $1, output in $WORK/out, and checks its exit status is $2
+check() {
+    "$SIMDIFF" -A --refresh -r "$1" "$SIM" 64 32 4 "$WORK/trace" > "$WORK/out" 2>&1
+    status=$?
+    [ $status = $2 ] || fail "$(basename "$1"): exit status $status, expected $2"
+}
+
+check "$WORK/reference" 0
+grep -q '^same: [1-9][0-9]* records' "$WORK/out" || fail "reference: not reported the same"
+
+# the 100th retire record retires a cycle later
+awk '/^[0-9]/ && $NF != "RT{0,0}" && ++records == 100 {
+        line = NR
+        split(substr($NF, 4), rt, /[,}]/)
+        sub(/RT\{[0-9]+,/, "RT{" rt[1] + 1 ",")
+    }
+    {print}
+    END {print line > "/dev/stderr"}' "$WORK/reference" > "$WORK/record" 2> "$WORK/line"
+line=$(cat "$WORK/line")
+check "$WORK/record" 1
+head -n 1 "$WORK/out" | grep -q '^DIVERGED$' || fail "record: not reported as DIVERGED"
+grep -q '^first divergence after 99 matching lines (99 records)$' "$WORK/out" || fail "record: wrong match count"
+grep -q "^> *$line  " "$WORK/out" || fail "record: reference line $line not shown"
+grep -q '^  RT begin: [0-9]* vs [0-9]*$' "$WORK/out" || fail "record: RT begin not named as the differing field"
+
+# one cycle more in the summary
+awk '/^# Cycles/ {sub(/[0-9]+$/, $NF + 1)} {print}' "$WORK/reference" > "$WORK/summary"
+cmp -s "$WORK/reference" "$WORK/summary" && fail "summary: edit did not change the reference"
+check "$WORK/summary" 1
+head -n 1 "$WORK/out" | grep -q '^DIVERGED$' || fail "summary: not reported as DIVERGED"
+grep -q '^> .*# Cycles' "$WORK/out" || fail "summary: the cycle count line not shown"
+
+# the reference stops halfway
+head -n $(($(wc -l < "$WORK/reference") / 2)) "$WORK/reference" > "$WORK/truncated"
+check "$WORK/truncated" 1
+head -n 1 "$WORK/out" | grep -q '^DIVERGED$' || fail "truncated: not reported as DIVERGED"
+grep -q '^> *(end of output)$' "$WORK/out" || fail "truncated: end of the reference not shown"
+
+# same output, then a crash
+cat > "$WORK/crash" <<EOF
+#!/bin/sh
+"$SIM" "\$@"
+kill -SEGV \$\$
+EOF
+chmod +x "$WORK/crash"
+"$SIMDIFF" -A --refresh -r "$WORK/reference" "$WORK/crash" 64 32 4 "$WORK/trace" > "$WORK/out" 2>&1
+status=$?
+[ $status = 2 ] || fail "crash: exit status $status, expected 2"
+head -n 1 "$WORK/out" | grep -q '^failed$' || fail "crash: not reported as failed"
+grep -q 'killed by signal 11$' "$WORK/out" || fail "crash: signal not reported"
+
+if [ $failed != 0 ]; then
+    cat "$WORK/out"
+fi
+
+[ $failed = 0 ] && echo "simdiff: reference edits diverge where they were made"
+exit $failed
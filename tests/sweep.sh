@@ -0,0 +1,83 @@
+#!/bin/sh
+# sim-coordinator with two local workers, over a unix socket and over TCP on 127.0.0.1. One worker is killed
+# while both are busy with long jobs: its job must go back in the queue and finish on the replacement, on its
+# second attempt. The short jobs read a trace whose path holds a comma and a space, which the CSV must quote
+# and the JSON must keep intact, and their counts must match a plain sim run. Sizes sim rejects are rejected
+# in the job file too.
+# Usage: sweep.sh <sim> <sim-coordinator> <tracefile>
+
+SIM=${1:-./sim}
+COORDINATOR=${2:-./sim-coordinator}
+TRACE=${3:-proj3-traces/val_trace_gcc1}
+WORK=$(mktemp -d) || exit 1
+trap 'rm -rf "$WORK"' EXIT
+failed=0
+
+fail() {
+    echo "FAIL: $*"
+    failed=1
+}
+
+# the long jobs take a few seconds each, enough to kill a worker in the middle of one
+for copy in $(seq 150); do cat "$TRACE"; done > "$WORK/long"
+SHORT="$WORK/short, trace"
+head -n 1000 "$TRACE" > "$SHORT"
+cat > "$WORK/jobs" <<EOF
+64 32 1 $WORK/long
+64 32 2 $WORK/long
+64 32 4 $SHORT
+32 16 2 $SHORT
+EOF
+
+# Counts from a plain run, as "<instructions> <cycles>"
+expected() {
+    SIM_CACHE_DIR="$WORK/cache" "$SIM" $1 $2 $3 "$SHORT" --refresh 2>/dev/null | awk '
+        /^# Dynamic Instruction Count/ {instructions = $NF}
+        /^# Cycles/ {cycles = $NF}
+        END {print instructions, cycles}'
+}
+
+# Runs the job file on two local workers listening on $1, writing $2, and kills one worker mid-job
+sweep() {
+    "$COORDINATOR" -j 2 -l "$1" -s "$SIM" -o "$2" "$WORK/jobs" 2> "$WORK/log" &
+    coordinator=$!
+    for tries in $(seq 100); do
+        [ "$(pgrep -P $coordinator | wc -l)" -ge 2 ] && break
+        sleep 0.1
+    done
+    sleep 0.5 # connected, and each has taken one of the long jobs
+    victim=$(pgrep -P $coordinator | head -n 1)
+    [ -n "$victim" ] && kill -KILL $victim
+    wait $coordinator || fail "$1: coordinator exited with $?"
+    grep -q "^sim-coordinator: worker exited on $WORK/long .*, requeued$" "$WORK/log" \
+        || fail "$1: the killed worker's job was not requeued"
+}
+
+sweep "unix:$WORK/socket" "$WORK/results.csv"
+[ "$(grep -c ',ok,' "$WORK/results.csv")" = 4 ] || fail "unix: expected 4 ok jobs"
+grep -q "^$WORK/long,64,32,[12],[0-9]*,[0-9]*,[0-9.]*,ok,2," "$WORK/results.csv" \
+    || fail "unix: no long job finished on its second attempt"
+set -- $(expected 64 32 4)
+grep -q "^\"$SHORT\",64,32,4,$1,$2," "$WORK/results.csv" || fail "unix: short trace row is not quoted or differs from sim"
+[ -S "$WORK/socket" ] && fail "unix: socket left behind"
+
+sweep "127.0.0.1:$((20000 + $$ % 20000))" "$WORK/results.json"
+[ "$(grep -c '"status": "ok"' "$WORK/results.json")" = 4 ] || fail "tcp: expected 4 ok jobs"
+grep -q "\"trace\": \"$WORK/long\", .*\"status\": \"ok\", \"attempts\": 2," "$WORK/results.json" \
+    || fail "tcp: no long job finished on its second attempt"
+set -- $(expected 32 16 2)
+grep -q "\"trace\": \"$SHORT\", \"rob_size\": 32, \"iq_size\": 16, \"width\": 2, \"instructions\": $1, \"cycles\": $2," \
+    "$WORK/results.json" || fail "tcp: short trace row differs from sim"
+
+if [ $failed != 0 ]; then
+    cat "$WORK/log"
+fi
+
+# sizes sim itself rejects
+echo "0 32 4 $SHORT" > "$WORK/bad"
+"$COORDINATOR" -j 1 -s "$SIM" "$WORK/bad" > /dev/null 2>&1 && fail "ROB_SIZE 0 accepted"
+echo "64 32 2000000 $SHORT" > "$WORK/bad"
+"$COORDINATOR" -j 1 -s "$SIM" "$WORK/bad" > /dev/null 2>&1 && fail "WIDTH 2000000 accepted"
+
+[ $failed = 0 ] && echo "sweep: requeued the killed worker's job, CSV and JSON as expected"
+exit $failed
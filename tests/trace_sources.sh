@@ -0,0 +1,49 @@
+#!/bin/sh
+# Every trace source must produce the same output as a plain file run. The results cache relies on it:
+# its key leaves out how the trace was read.
+# Short prefixes cover lengths that are and are not a multiple of WIDTH, which is where a source reporting
+# Done() early ends the core a cycle sooner. The run stops once fetch runs dry, so only the longer
+# prefixes and the whole trace get instructions through to retire; those must retire some.
+# Usage: trace_sources.sh <sim> <tracefile>
+
+SIM=${1:-./sim}
+TRACE=${2:-proj3-traces/val_trace_gcc1}
+WORK=$(mktemp -d) || exit 1
+trap 'rm -rf "$WORK"' EXIT
+failed=0
+
+# --refresh always simulates, and it prints the results summary, so the cycle counts are compared too
+export SIM_CACHE_DIR="$WORK/cache"
+
+for length in 1 2 3 4 5 16 1000 1001 1002 1003 all; do
+    if [ $length = all ]; then
+        cp "$TRACE" "$WORK/trace"
+    else
+        head -n $length "$TRACE" > "$WORK/trace"
+    fi
+    for width in 1 2 3 4 8; do
+        timeout 60 "$SIM" 64 32 $width "$WORK/trace" --refresh > "$WORK/plain" 2>/dev/null
+        retired=$(sed -n 's/^# Dynamic Instruction Count *= *//p' "$WORK/plain")
+        if { [ $length = all ] || [ $length -ge 1000 ]; } && [ "${retired:-0}" -eq 0 ]; then
+            echo "FAIL: $length records, width $width: nothing retired"
+            failed=1
+        fi
+        for option in --shm-trace-clean --async-io --memoize; do
+            timeout 60 "$SIM" 64 32 $width "$WORK/trace" --refresh $option > "$WORK/other" 2> "$WORK/stderr"
+            if ! cmp -s "$WORK/plain" "$WORK/other"; then
+                echo "FAIL: $length records, width $width: $option output differs from plain"
+                diff "$WORK/plain" "$WORK/other" | head -n 6
+                failed=1
+            fi
+        done
+        # the last run was --memoize; at width 1 the whole trace settles into loops it must fast-forward
+        if [ $length = all ] && [ $width = 1 ] && grep -q '^memo: 0 of [0-9]* loop-head snapshots hit' "$WORK/stderr"; then
+            echo "FAIL: whole trace, width 1: --memoize never hit"
+            grep '^memo:' "$WORK/stderr"
+            failed=1
+        fi
+    done
+done
+
+[ $failed = 0 ] && echo "trace sources: all outputs match"
+exit $failed
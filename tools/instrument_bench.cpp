@@ -0,0 +1,126 @@
+// instrument_bench: times Simulator::Step() under every instrumentation policy.
+// "none" should match a build with no debug output at all; output of the other policies goes to /dev/null.
+// Built with -DINSTRUMENT_BENCH_BASELINE against a tree from before the policies it times that tree's plain Step(),
+// with its DO_* debug macros off. tools/instrument_bench.sh builds both at -O2 and compares them.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#ifdef INSTRUMENT_BENCH_BASELINE
+#include "../Simulator.h"
+#else
+#include "../Instrumentation.h"
+#endif
+
+#define BENCH_CYCLES (1 << 18)
+#define BENCH_REPEAT 5
+
+static std::vector<TraceRecord> LoadRecords(const char *path) {
+    std::vector<TraceRecord> records;
+    if (path) {
+        FileTraceSource trace(path);
+        TraceRecord record;
+        while (trace.Next(record)) records.push_back(record);
+        if (!records.empty()) return records;
+        fprintf(stderr, "No records in `%s', using random instructions\n", path);
+    }
+    std::mt19937 rng(463);
+    std::uniform_int_distribution<int> reg(-1, ARCHITECTURAL_REGISTER_COUNT - 1);
+    for (int i = 0; i < BENCH_CYCLES; i++) {
+        records.push_back({static_cast<uint64_t>(i) * 4, i % 3, reg(rng), reg(rng), reg(rng)});
+    }
+    return records;
+}
+
+#ifdef INSTRUMENT_BENCH_BASELINE
+// Best of BENCH_REPEAT runs, in ns per simulated cycle
+static double Time(const SimConfig &config, const std::vector<TraceRecord> &records) {
+    double best = 0;
+    for (int r = 0; r < BENCH_REPEAT; r++) {
+        Simulator simulator(config);
+        simulator.Feed(records.data(), records.size());
+        simulator.CloseInput();
+        auto start = std::chrono::steady_clock::now();
+        uint64_t cycles = simulator.Step(BENCH_CYCLES);
+        auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        if (cycles && (r == 0 || ns / cycles < best)) best = ns / cycles;
+    }
+    return best;
+}
+#else
+// Best of BENCH_REPEAT runs, in ns per simulated cycle
+template <typename Policy>
+static double Time(const SimConfig &config, const std::vector<TraceRecord> &records, Policy &policy) {
+    double best = 0;
+    for (int r = 0; r < BENCH_REPEAT; r++) {
+        Simulator simulator(config);
+        simulator.Feed(records.data(), records.size());
+        simulator.CloseInput();
+        policy.Begin(simulator); // Step() leaves these to the caller
+        auto start = std::chrono::steady_clock::now();
+        uint64_t cycles = simulator.Step(BENCH_CYCLES, policy);
+        auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        policy.End(simulator);
+        if (cycles && (r == 0 || ns / cycles < best)) best = ns / cycles;
+    }
+    return best;
+}
+#endif
+
+static void Usage() {
+    fprintf(stderr, "Usage: instrument_bench [-n] <ROB_SIZE> <IQ_SIZE> <WIDTH> [tracefile]\n"
+        "  -n  time the \"none\" policy only\n");
+    exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+    bool none_only = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "n")) != -1) {
+        if (opt != 'n') Usage();
+        none_only = true;
+    }
+    if (argc - optind < 3 || argc - optind > 4) Usage();
+    argv += optind;
+    SimConfig config{atoi(argv[0]), atoi(argv[1]), atoi(argv[2])};
+    auto records = LoadRecords(argc - optind == 4 ? argv[3] : nullptr);
+#ifdef INSTRUMENT_BENCH_BASELINE
+    printf("%-10s %10s\n", "build", "ns/cycle");
+    printf("%-10s %10.2f\n", "baseline", Time(config, records));
+    return 0;
+#else
+    NoInstrumentation none;
+    double base = Time(config, records, none);
+    printf("%-10s %10s %8s\n", "policy", "ns/cycle", "vs none");
+    printf("%-10s %10.2f %7.2fx\n", "none", base, 1.0);
+    if (none_only) return 0;
+
+    FILE *null = fopen("/dev/null", "w");
+    char dir[] = "/tmp/instrument_bench.XXXXXX";
+    if (!null || !mkdtemp(dir)) {
+        fprintf(stderr, "Cannot set up output sinks, exiting...\n");
+        exit(-1);
+    }
+    CounterInstrumentation counters(null);
+    CycleDumpInstrumentation dump(null);
+    LatchLogInstrumentation latches(dir);
+    EventTraceInstrumentation events(null);
+
+    auto report = [&](const char *name, double ns) {printf("%-10s %10.2f %7.2fx\n", name, ns, ns / base);};
+    report("counters", Time(config, records, counters));
+    report("cycles", Time(config, records, dump));
+    report("latches", Time(config, records, latches));
+    report("events", Time(config, records, events));
+
+    fclose(null);
+    const char *logs[] = {"dispatch.csv", "rename.csv", "decode.csv", "regread.csv", "writeback.csv"};
+    for (auto log : logs) remove((std::string(dir) + "/" + log).c_str());
+    rmdir(dir);
+    return 0;
+#endif
+}
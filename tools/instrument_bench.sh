@@ -0,0 +1,60 @@
+#!/bin/sh
+# Compares Step() under the "none" policy with a tree from before the instrumentation policies, where the
+# DO_* debug macros were compiled out. The baseline is the commit given with -b, usually the parent of the
+# commit that replaced the macros. Both libsims and both benches are built at -O2 from clean copies.
+# The new side is the working tree, or the commit given with -n.
+# Usage: tools/instrument_bench.sh -b baseline-commit [-n new-commit] [<ROB_SIZE> <IQ_SIZE> <WIDTH> [tracefile]]
+# The default config keeps IQ_SIZE >= ROB_SIZE, where the core never prints an IQ insert error per cycle.
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+usage() {
+    echo "Usage: $0 -b baseline-commit [-n new-commit] [<ROB_SIZE> <IQ_SIZE> <WIDTH> [tracefile]]" >&2
+    exit 1
+}
+BASE=
+NEW=
+while getopts b:n: opt; do
+    case $opt in
+        b) BASE=$OPTARG ;;
+        n) NEW=$OPTARG ;;
+        *) usage ;;
+    esac
+done
+[ -n "$BASE" ] || usage
+git -C "$ROOT" rev-parse -q --verify "$BASE^{commit}" > /dev/null || { echo "Unknown baseline commit $BASE" >&2; exit 1; }
+shift $((OPTIND - 1))
+[ $# -ge 3 ] || set -- 64 64 4 "$ROOT/proj3-traces/val_trace_gcc1"
+
+WORK=$(mktemp -d) || exit 1
+trap 'rm -rf "$WORK"' EXIT
+FLAGS="-std=c++17 -pthread -fPIC -O2"
+mkdir -p "$WORK/base/tools" "$WORK/head/tools"
+git -C "$ROOT" archive "$BASE" | tar -x -C "$WORK/base" || exit 1
+if [ -n "$NEW" ]; then
+    git -C "$ROOT" archive "$NEW" | tar -x -C "$WORK/head" || exit 1
+else
+    cp "$ROOT"/*.cpp "$ROOT"/*.h "$ROOT"/Makefile "$WORK/head/"
+fi
+for tree in base head; do
+    cp "$ROOT/tools/instrument_bench.cpp" "$WORK/$tree/tools/"
+    make -s -C "$WORK/$tree" libsim.a CXXFLAGS="$FLAGS" > /dev/null || exit 1
+done
+g++ $FLAGS -DINSTRUMENT_BENCH_BASELINE "$WORK/base/tools/instrument_bench.cpp" "$WORK/base/libsim.a" \
+    -o "$WORK/base/instrument_bench" || exit 1
+g++ $FLAGS "$WORK/head/tools/instrument_bench.cpp" "$WORK/head/libsim.a" -o "$WORK/head/instrument_bench" || exit 1
+
+echo "# $*: ${NEW:-working tree} against $(git -C "$ROOT" rev-parse --short "$BASE"), both at -O2"
+"$WORK/head/instrument_bench" "$@"
+# only the interleaved runs are compared, so drift on the machine hits both builds alike; each keeps its best
+ROUNDS=${ROUNDS:-10}
+round=0
+while [ $round -lt $ROUNDS ]; do
+    "$WORK/base/instrument_bench" "$@" >> "$WORK/base.txt"
+    "$WORK/head/instrument_bench" -n "$@" >> "$WORK/head.txt"
+    round=$((round + 1))
+done
+awk -v rounds=$ROUNDS '
+    $1 == "baseline" && (!base || $2 < base) {base = $2}
+    $1 == "none" && (!none || $2 < none) {none = $2}
+    END {printf("best of %d: baseline %.2f, none %.2f ns/cycle, none vs baseline %.2fx\n", rounds, base, none, none / base)}
+' "$WORK/base.txt" "$WORK/head.txt"
@@ -0,0 +1,160 @@
+// rename_bench: checks Rename_Bundle() against Rename_Sequential() and times both for WIDTH 1..16.
+// Bundles are drawn from a trace when one is given, otherwise from random registers.
+// The ROB is modelled full: each bundle retires the one renamed ROB_SIZE instructions earlier and clears
+// its RMT entries like Simulator::Retire(), so sources see the producer mix of a running core.
+// Usage: rename_bench [tracefile|-] [ROB_SIZE], "-" for random registers; ROB_SIZE defaults to 64.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "../Rename.h"
+
+#define BENCH_INSTRUCTIONS (1 << 24)
+#define BENCH_POOL 256
+#define BENCH_CHECKED (1 << 16) // records checked against Rename_Sequential(), the check keeps every RMT
+
+static std::vector<TraceRecord> LoadRecords(const char *path) {
+    std::vector<TraceRecord> records;
+    if (path) {
+        FileTraceSource trace(path);
+        TraceRecord record;
+        while (trace.Next(record)) records.push_back(record);
+        if (!records.empty()) return records;
+        fprintf(stderr, "No records in `%s', using random registers\n", path);
+    }
+    std::mt19937 rng(463);
+    std::uniform_int_distribution<int> reg(-1, ARCHITECTURAL_REGISTER_COUNT - 1);
+    for (int i = 0; i < BENCH_INSTRUCTIONS; i++) {
+        records.push_back({static_cast<uint64_t>(i) * 4, i % 3, reg(rng), reg(rng), reg(rng)});
+    }
+    return records;
+}
+
+// The instructions still in flight, oldest first, as (dst, ROB slot) pairs
+struct InFlight {
+    std::vector<int> dst, rob;
+    size_t head = 0, count = 0;
+
+    explicit InFlight(size_t rob_size) : dst(rob_size), rob(rob_size) {}
+
+    // Retires the oldest entries until count more fit, then adds them
+    void Enter(RenameMapTable &rmt, Instruction **bundle, size_t count_in) {
+        size_t size = dst.size();
+        while (count + count_in > size) {
+            if (dst[head] >= 0 && rmt[dst[head]] == rob[head]) rmt[dst[head]] = -1;
+            head = head + 1 == size ? 0 : head + 1;
+            count--;
+        }
+        for (size_t k = 0; k < count_in; k++) {
+            size_t slot = (head + count++) % size;
+            dst[slot] = bundle[k]->dst;
+            rob[slot] = static_cast<int>(bundle[k]->rob_index);
+        }
+    }
+};
+
+// Renames every bundle of width instructions once, collecting the RMT after each bundle
+template <typename RenameFn>
+static void Check(RenameFn rename, std::vector<Instruction> &instrs, size_t width, uint32_t rob_size,
+                  std::vector<int> &rmt_after) {
+    std::vector<Instruction*> bundle(width);
+    RenameMapTable rmt;
+    rmt.fill(-1);
+    InFlight in_flight(rob_size);
+    for (size_t base = 0; base + width <= instrs.size(); base += width) {
+        for (size_t k = 0; k < width; k++) {
+            instrs[base + k].rob_index = (base + k) % rob_size;
+            bundle[k] = &instrs[base + k];
+        }
+        in_flight.Enter(rmt, bundle.data(), width);
+        rename(rmt, bundle.data(), width);
+        rmt_after.insert(rmt_after.end(), rmt.begin(), rmt.end());
+    }
+}
+
+// Streams the records through a small pool of Instructions, as a pipeline latch would see them,
+// and returns ns per renamed instruction
+template <typename RenameFn>
+static double Time(RenameFn rename, const std::vector<TraceRecord> &records, size_t width, uint32_t rob_size) {
+    size_t pool_size = BENCH_POOL / width * width;
+    std::vector<Instruction> pool;
+    for (size_t i = 0; i < pool_size; i++) pool.emplace_back(records[i % records.size()], i);
+    std::vector<Instruction*> bundle(width);
+    RenameMapTable rmt;
+    rmt.fill(-1);
+    InFlight in_flight(rob_size);
+    size_t next = 0, renamed = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (renamed < BENCH_INSTRUCTIONS) {
+        for (size_t base = 0; base < pool_size; base += width) {
+            for (size_t k = 0; k < width; k++) {
+                auto &record = records[next];
+                next = next + 1 == records.size() ? 0 : next + 1;
+                auto &instr = pool[base + k];
+                instr.dst = record.dst;
+                instr.src1 = record.src1;
+                instr.src2 = record.src2;
+                instr.rob_index = (renamed + k) % rob_size;
+                bundle[k] = &instr;
+            }
+            in_flight.Enter(rmt, bundle.data(), width);
+            rename(rmt, bundle.data(), width);
+            renamed += width;
+        }
+    }
+    auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return ns / renamed;
+}
+
+static std::vector<Instruction> Fresh(const std::vector<TraceRecord> &records) {
+    std::vector<Instruction> instrs;
+    instrs.reserve(records.size());
+    for (size_t i = 0; i < records.size(); i++) instrs.emplace_back(records[i], i);
+    return instrs;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 3) {
+        fprintf(stderr, "Usage: rename_bench [tracefile] [ROB_SIZE]\n");
+        exit(-1);
+    }
+    auto records = LoadRecords(argc >= 2 && strcmp(argv[1], "-") ? argv[1] : nullptr);
+    const uint32_t rob_size = argc == 3 ? atoi(argv[2]) : 64;
+    if (rob_size < 16) {
+        fprintf(stderr, "ROB_SIZE must hold a 16-wide bundle\n");
+        exit(-1);
+    }
+
+    std::vector<TraceRecord> checked(records.begin(), records.begin() + std::min<size_t>(records.size(), BENCH_CHECKED));
+
+    printf("# ROB %u\n", rob_size);
+    printf("%5s %12s %12s %8s\n", "width", "seq ns/inst", "bundle ns/inst", "speedup");
+    for (size_t width = 1; width <= 16; width++) {
+        // correctness: identical renamed operands and RMT after every bundle
+        auto seq = Fresh(checked), bun = Fresh(checked);
+        std::vector<int> seq_rmt, bun_rmt;
+        Check(Rename_Sequential, seq, width, rob_size, seq_rmt);
+        Check(Rename_Bundle, bun, width, rob_size, bun_rmt);
+        for (size_t i = 0; i < seq.size() / width * width; i++) { // the ragged tail is never renamed
+            if (seq[i].src1 != bun[i].src1 || seq[i].src2 != bun[i].src2
+                || seq[i].src1_meta != bun[i].src1_meta || seq[i].src2_meta != bun[i].src2_meta) {
+                printf("MISMATCH: width %zu instruction %zu\n", width, i);
+                return 1;
+            }
+        }
+        if (seq_rmt != bun_rmt) {
+            printf("MISMATCH: width %zu RMT\n", width);
+            return 1;
+        }
+
+        double seq_ns = Time(Rename_Sequential, records, width, rob_size);
+        double bun_ns = Time(Rename_Bundle, records, width, rob_size);
+        printf("%5zu %12.3f %12.3f %7.2fx\n", width, seq_ns, bun_ns, seq_ns / bun_ns);
+    }
+    return 0;
+}
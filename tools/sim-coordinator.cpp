@@ -0,0 +1,381 @@
+// sim-coordinator: runs a list of (trace, ROB, IQ, WIDTH) jobs on `sim --worker` processes and collects the
+// results into one CSV or JSON file. Jobs go out longest first, by trace size, so the biggest ones do not end up
+// alone at the tail of the sweep. A job whose worker dies or times out goes back in the queue, up to a retry limit.
+// Local workers are forked from -s; more can join from other machines with `sim --worker=<host>:<port>`
+// as long as the coordinator listens on TCP and the trace paths resolve on their side too.
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "../Simulator.h"
+#include "../Sweep.h"
+
+#define POLL_INTERVAL_MS 250
+
+typedef std::chrono::steady_clock Clock;
+
+enum JobStatus {JOB_PENDING, JOB_RUNNING, JOB_DONE, JOB_FAILED};
+
+struct Job {
+    SweepJob spec;
+    off_t trace_bytes;
+    int attempts = 0;
+    JobStatus status = JOB_PENDING;
+    SweepResult result = {};
+    std::string error;
+};
+
+struct Worker {
+    int fd;
+    pid_t pid = 0; // reported in HELLO
+    bool ready = false;
+    std::string buffer;
+    Job *job = nullptr;
+    Clock::time_point started;
+};
+
+// "<ROB> <IQ> <WIDTH> <trace>" per line, like sim's arguments; blank lines and # comments are skipped
+static bool ReadJobs(const char *path, std::vector<Job> &jobs) {
+    FILE *in = strcmp(path, "-") ? fopen(path, "r") : stdin;
+    if (!in) return false;
+    char line[4096];
+    for (int number = 1; fgets(line, sizeof(line), in); number++) {
+        line[strcspn(line, "\r\n")] = 0;
+        const char *text = line + strspn(line, " \t");
+        if (!*text || *text == '#') continue;
+        Job job;
+        int offset = 0;
+        if (sscanf(text, "%d %d %d %n", &job.spec.rob_size, &job.spec.iq_size, &job.spec.width, &offset) != 3
+            || !offset || !text[offset] || !job.spec.Valid()) {
+            fprintf(stderr, "%s:%d: expected <ROB> <IQ> <WIDTH> <trace>, sizes between 1 and %d\n", path, number,
+                SIM_MAX_CONFIG);
+            if (in != stdin) fclose(in);
+            return false;
+        }
+        job.spec.trace = text + offset;
+        job.spec.id = jobs.size() + 1;
+        jobs.push_back(job);
+    }
+    if (in != stdin) fclose(in);
+    return true;
+}
+
+static pid_t SpawnWorker(const char *sim, const std::string &address) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        // the core reports its own errors on stdout, keep that out of the coordinator's output
+        int null = open("/dev/null", O_WRONLY);
+        if (null >= 0) dup2(null, STDOUT_FILENO);
+        std::string option = "--worker=" + address;
+        execl(sim, sim, option.c_str(), static_cast<char*>(nullptr));
+        fprintf(stderr, "Cannot run `%s': %s\n", sim, strerror(errno));
+        _exit(127);
+    }
+    if (pid < 0) perror("fork");
+    return pid;
+}
+
+// RFC 4180: a field holding a comma, quote or line break goes in quotes, with its quotes doubled
+static std::string CsvField(const std::string &text) {
+    if (text.find_first_of(",\"\r\n") == std::string::npos) return text;
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"') quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+static void WriteCsv(FILE *out, const std::vector<Job> &jobs) {
+    fprintf(out, "trace,rob_size,iq_size,width,instructions,cycles,ipc,status,attempts,seconds\n");
+    for (auto &job : jobs) {
+        const char *status = job.status != JOB_DONE ? "failed" : job.result.stalled ? "stalled" : "ok";
+        fprintf(out, "%s,%d,%d,%d,%llu,%llu,%.4f,%s,%d,%.3f\n", CsvField(job.spec.trace).c_str(),
+            job.spec.rob_size, job.spec.iq_size, job.spec.width, (unsigned long long)job.result.instructions,
+            (unsigned long long)job.result.cycles, job.result.ipc, status, job.attempts, job.result.seconds);
+    }
+}
+
+static std::string JsonString(const std::string &text) {
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') quoted += '\\';
+        if (static_cast<unsigned char>(c) < 0x20) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            quoted += escape;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+static void WriteJson(FILE *out, const std::vector<Job> &jobs) {
+    fprintf(out, "[\n");
+    for (size_t i = 0; i < jobs.size(); i++) {
+        auto &job = jobs[i];
+        const char *status = job.status != JOB_DONE ? "failed" : job.result.stalled ? "stalled" : "ok";
+        fprintf(out, "  {\"trace\": %s, \"rob_size\": %d, \"iq_size\": %d, \"width\": %d, \"instructions\": %llu, "
+            "\"cycles\": %llu, \"ipc\": %.4f, \"status\": \"%s\", \"attempts\": %d, \"seconds\": %.3f",
+            JsonString(job.spec.trace).c_str(), job.spec.rob_size, job.spec.iq_size, job.spec.width,
+            (unsigned long long)job.result.instructions, (unsigned long long)job.result.cycles, job.result.ipc,
+            status, job.attempts, job.result.seconds);
+        if (!job.error.empty()) fprintf(out, ", \"error\": %s", JsonString(job.error).c_str());
+        fprintf(out, "}%s\n", i + 1 < jobs.size() ? "," : "");
+    }
+    fprintf(out, "]\n");
+}
+
+static void Usage() {
+    fprintf(stderr, "Usage: sim-coordinator [-j local_workers] [-l unix:<path>|<host>:<port>] [-s sim_binary]"
+        " [-r retries] [-t timeout_seconds] [-o results.csv|results.json] <jobfile|->\n"
+        "  jobfile lines: <ROB_SIZE> <IQ_SIZE> <WIDTH> <tracefile>\n");
+    exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+    int local_workers = std::max(1u, std::thread::hardware_concurrency());
+    std::string address = "unix:/tmp/sim-coordinator." + std::to_string(getpid()) + ".sock";
+    const char *sim = "./sim";
+    int retries = 2;
+    double timeout = 0;
+    const char *out_path = nullptr;
+    int opt;
+    while ((opt = getopt(argc, argv, "j:l:s:r:t:o:")) != -1) {
+        switch (opt) {
+            case 'j': local_workers = std::max(0, atoi(optarg)); break;
+            case 'l': address = optarg; break;
+            case 's': sim = optarg; break;
+            case 'r': retries = std::max(0, atoi(optarg)); break;
+            case 't': timeout = atof(optarg); break;
+            case 'o': out_path = optarg; break;
+            default: Usage();
+        }
+    }
+    if (optind != argc - 1) Usage();
+
+    std::vector<Job> jobs;
+    if (!ReadJobs(argv[optind], jobs)) {
+        fprintf(stderr, "Cannot read job list `%s', exiting...\n", argv[optind]);
+        exit(-1);
+    }
+
+    // Longest job first: the queue is popped from the back, so it is sorted by ascending trace size
+    std::vector<Job*> queue;
+    for (auto &job : jobs) {
+        struct stat info;
+        if (stat(job.spec.trace.c_str(), &info) != 0) {
+            job.status = JOB_FAILED;
+            job.error = "cannot stat trace";
+            continue;
+        }
+        job.trace_bytes = info.st_size;
+        queue.push_back(&job);
+    }
+    std::stable_sort(queue.begin(), queue.end(), [](const Job *a, const Job *b) {
+        return a->trace_bytes != b->trace_bytes ? a->trace_bytes < b->trace_bytes : a->spec.id > b->spec.id;
+    });
+
+    signal(SIGPIPE, SIG_IGN);
+    int listener = Sweep_Listen(address.c_str());
+    if (listener < 0) exit(-1);
+
+    std::vector<pid_t> children;
+    // a binary that dies on startup must not be respawned forever
+    int spawns_left = local_workers + static_cast<int>(queue.size()) * retries;
+    for (int i = 0; i < local_workers && i < static_cast<int>(queue.size()); i++) {
+        pid_t pid = SpawnWorker(sim, address);
+        if (pid > 0) children.push_back(pid);
+        spawns_left--;
+    }
+    if (!queue.empty()) {
+        fprintf(stderr, "sim-coordinator: %zu jobs, %zu local workers, listening on %s\n", queue.size(),
+            children.size(), address.c_str());
+    }
+
+    auto start = Clock::now();
+    size_t remaining = queue.size(), finished = 0, retried = 0, connections = 0;
+    std::vector<Worker> workers;
+
+    // Worker is gone: its job goes back in the queue unless it ran out of attempts
+    auto drop = [&](Worker &worker, const char *reason) {
+        close(worker.fd);
+        worker.fd = -1;
+        if (!worker.job) return;
+        Job &job = *worker.job;
+        worker.job = nullptr;
+        if (job.attempts > retries) {
+            job.status = JOB_FAILED;
+            job.error = reason;
+            remaining--;
+            fprintf(stderr, "[%zu/%zu] %s %d %d %d: %s, giving up after %d attempts\n", ++finished, jobs.size(),
+                job.spec.trace.c_str(), job.spec.rob_size, job.spec.iq_size, job.spec.width, reason, job.attempts);
+        } else {
+            job.status = JOB_PENDING;
+            queue.push_back(&job); // retried next, it was among the longest left anyway
+            retried++;
+            fprintf(stderr, "sim-coordinator: %s on %s %d %d %d, requeued\n", reason, job.spec.trace.c_str(),
+                job.spec.rob_size, job.spec.iq_size, job.spec.width);
+        }
+    };
+
+    while (remaining > 0) {
+        std::vector<pollfd> fds = {{listener, POLLIN, 0}};
+        for (auto &worker : workers) fds.push_back({worker.fd, POLLIN, 0});
+        if (poll(fds.data(), fds.size(), POLL_INTERVAL_MS) < 0 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd >= 0) {
+                Worker worker;
+                worker.fd = fd;
+                workers.push_back(worker);
+                connections++;
+            }
+        }
+
+        for (size_t i = 1; i < fds.size(); i++) {
+            Worker &worker = workers[i - 1];
+            if (!fds[i].revents) continue;
+            char data[4096];
+            auto n = read(worker.fd, data, sizeof(data));
+            if (n <= 0) {
+                drop(worker, "worker exited");
+                continue;
+            }
+            worker.buffer.append(data, n);
+            std::string message;
+            int extracted;
+            while (worker.fd >= 0 && (extracted = Sweep_Extract(worker.buffer, message)) != 0) {
+                SweepResult result;
+                if (extracted < 0) {
+                    drop(worker, "oversized message");
+                } else if (!strncmp(message.c_str(), "HELLO ", 6)) {
+                    worker.pid = atoi(message.c_str() + 6);
+                    worker.ready = true;
+                } else if (worker.job && SweepResult::Decode(message, result) && result.id == worker.job->spec.id) {
+                    Job &job = *worker.job;
+                    worker.job = nullptr;
+                    job.result = result;
+                    // ERROR replies are about the job itself (a bad trace), running it again would not help
+                    job.status = result.error.empty() ? JOB_DONE : JOB_FAILED;
+                    job.error = result.error;
+                    remaining--;
+                    if (job.status == JOB_DONE) {
+                        fprintf(stderr, "[%zu/%zu] %s %d %d %d: IPC %.4f%s, %.1f s\n", ++finished, jobs.size(),
+                            job.spec.trace.c_str(), job.spec.rob_size, job.spec.iq_size, job.spec.width, result.ipc,
+                            result.stalled ? " (stalled)" : "", result.seconds);
+                    } else {
+                        fprintf(stderr, "[%zu/%zu] %s %d %d %d: %s\n", ++finished, jobs.size(),
+                            job.spec.trace.c_str(), job.spec.rob_size, job.spec.iq_size, job.spec.width,
+                            result.error.c_str());
+                    }
+                } else {
+                    drop(worker, "protocol error");
+                }
+            }
+        }
+
+        if (timeout > 0) {
+            for (auto &worker : workers) {
+                if (worker.fd < 0 || !worker.job) continue;
+                if (std::chrono::duration<double>(Clock::now() - worker.started).count() < timeout) continue;
+                // Only our own children can be killed, a remote worker just loses its connection
+                if (std::find(children.begin(), children.end(), worker.pid) != children.end()) kill(worker.pid, SIGKILL);
+                drop(worker, "timed out");
+            }
+        }
+        workers.erase(std::remove_if(workers.begin(), workers.end(), [](const Worker &worker) {
+            return worker.fd < 0;
+        }), workers.end());
+
+        // Replace local workers that died while work is left
+        pid_t pid;
+        int status;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            children.erase(std::remove(children.begin(), children.end(), pid), children.end());
+            if (WIFSIGNALED(status)) fprintf(stderr, "sim-coordinator: worker %d killed by signal %d\n", pid, WTERMSIG(status));
+            if (!queue.empty() && spawns_left > 0) {
+                pid_t spawned = SpawnWorker(sim, address);
+                if (spawned > 0) children.push_back(spawned);
+                spawns_left--;
+            }
+        }
+        if (local_workers > 0 && children.empty() && workers.empty() && spawns_left <= 0) {
+            fprintf(stderr, "sim-coordinator: no workers left, %zu jobs unfinished\n", remaining);
+            break;
+        }
+
+        for (auto &worker : workers) {
+            if (!worker.ready || worker.job || queue.empty()) continue;
+            Job &job = *queue.back();
+            queue.pop_back();
+            job.status = JOB_RUNNING;
+            job.attempts++;
+            worker.job = &job;
+            worker.started = Clock::now();
+            if (!Sweep_Send(worker.fd, job.spec.Encode())) drop(worker, "worker unreachable");
+        }
+    }
+
+    for (auto &worker : workers) {
+        if (worker.fd < 0) continue;
+        Sweep_Send(worker.fd, "QUIT");
+        close(worker.fd);
+    }
+    for (auto pid : children) waitpid(pid, nullptr, 0);
+    close(listener);
+    if (!strncmp(address.c_str(), "unix:", 5)) unlink(address.c_str() + 5);
+
+    for (auto &job : jobs) {
+        if (job.status == JOB_PENDING || job.status == JOB_RUNNING) {
+            job.status = JOB_FAILED;
+            job.error = "not run";
+        }
+    }
+    FILE *out = out_path && strcmp(out_path, "-") ? fopen(out_path, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Cannot create `%s', writing results to stdout\n", out_path);
+        out = stdout;
+    }
+    size_t length = out_path ? strlen(out_path) : 0;
+    if (length >= 5 && !strcmp(out_path + length - 5, ".json")) {
+        WriteJson(out, jobs);
+    } else {
+        WriteCsv(out, jobs);
+    }
+    if (out != stdout) fclose(out);
+
+    size_t ok = 0, stalled = 0, failed = 0;
+    double busy = 0;
+    for (auto &job : jobs) {
+        if (job.status != JOB_DONE) failed++;
+        else if (job.result.stalled) stalled++;
+        else ok++;
+        busy += job.result.seconds;
+    }
+    double wall = std::chrono::duration<double>(Clock::now() - start).count();
+    fprintf(stderr, "sim-coordinator: %zu ok, %zu stalled, %zu failed, %zu retries, %zu worker connections,"
+        " %.1f s wall, %.1f s simulated (%.2fx)\n", ok, stalled, failed, retried, connections, wall, busy,
+        wall > 0 ? busy / wall : 0.0);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,454 @@
+// simdiff: differential check of the timing output of two simulator builds, or of one build against a reference
+// timing file. Both streams are compared line by line while the simulators run, holding only a few context lines,
+// and the check stops at the first divergence with the config that caused it and the fields that differ.
+// Grid mode repeats the check over every ROB x IQ x WIDTH config and trace, several configs at a time.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdarg>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <dirent.h>
+#include <fcntl.h>
+#include <mutex>
+#include <poll.h>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define READ_CHUNK (1 << 16)
+#define MAX_BUFFERED (1 << 20) // stop reading the faster stream once this far ahead, the pipe throttles it
+#define NUM_FIELDS 23
+
+static const char *field_str[NUM_FIELDS] = {
+    "seq", "fu", "src1", "src2", "dst",
+    "FE begin", "FE length", "DE begin", "DE length", "RN begin", "RN length", "RR begin", "RR length",
+    "DI begin", "DI length", "IS begin", "IS length", "EX begin", "EX length", "WB begin", "WB length",
+    "RT begin", "RT length"};
+
+// "<seq> fu{..} src{..,..} dst{..} FE{..,..} ... RT{..,..}" into NUM_FIELDS numbers
+static bool ParseRecord(const std::string &line, long long fields[NUM_FIELDS]) {
+    return sscanf(line.c_str(), "%lld fu{%lld} src{%lld,%lld} dst{%lld} FE{%lld,%lld} DE{%lld,%lld} RN{%lld,%lld}"
+        " RR{%lld,%lld} DI{%lld,%lld} IS{%lld,%lld} EX{%lld,%lld} WB{%lld,%lld} RT{%lld,%lld}",
+        &fields[0], &fields[1], &fields[2], &fields[3], &fields[4], &fields[5], &fields[6], &fields[7], &fields[8],
+        &fields[9], &fields[10], &fields[11], &fields[12], &fields[13], &fields[14], &fields[15], &fields[16],
+        &fields[17], &fields[18], &fields[19], &fields[20], &fields[21], &fields[22]) == NUM_FIELDS;
+}
+
+// A retire record is a timing line with a nonzero RT field, the rule simstat counts by. The core also prints every
+// instruction as it leaves register read, with RT{0,0}; those lines are debug output, not records.
+static bool RetireRecord(const std::string &line) {
+    long long fields[NUM_FIELDS];
+    return !line.empty() && line[0] >= '0' && line[0] <= '9' && ParseRecord(line, fields)
+        && (fields[NUM_FIELDS - 2] || fields[NUM_FIELDS - 1]);
+}
+
+// Retire records and the "# ..." results summary are compared; anything else the core prints (its ERROR
+// messages, the register read lines) is skipped unless every line is compared. sim only prints the summary with
+// caching on, so pass --cache or --refresh (-A/-B) or set SIM_CACHE_DIR to compare cycle counts as well.
+static bool Compared(const std::string &line, bool all_lines) {
+    if (all_lines || line.empty()) return all_lines;
+    return line[0] == '#' || RetireRecord(line);
+}
+
+// One side of the comparison: a simulator's stdout or a reference file, read in chunks as it becomes available
+struct Stream {
+    std::string name;
+    int fd = -1;
+    pid_t pid = 0;
+    std::string buffer;
+    size_t position = 0;
+    bool eof = false;
+    uint64_t line_number = 0;
+    std::string failure; // how the simulator died, set by Close()
+
+    // Next complete line, or false if more input is needed (or the stream has ended)
+    bool Line(std::string &line) {
+        size_t end = buffer.find('\n', position);
+        if (end == std::string::npos) {
+            if (!eof || position == buffer.size()) return false;
+            end = buffer.size(); // last line without a newline
+        }
+        line.assign(buffer, position, end - position);
+        position = std::min(end + 1, buffer.size());
+        line_number++;
+        if (position > READ_CHUNK) { // drop consumed input now and then
+            buffer.erase(0, position);
+            position = 0;
+        }
+        return true;
+    }
+
+    [[nodiscard]] bool Finished() const {return eof && position == buffer.size();}
+    [[nodiscard]] bool Full() const {return buffer.size() - position >= MAX_BUFFERED;}
+
+    void Read() {
+        char data[READ_CHUNK];
+        auto n = read(fd, data, sizeof(data));
+        if (n < 0 && (errno == EINTR || errno == EAGAIN)) return;
+        if (n <= 0) eof = true;
+        else buffer.append(data, n);
+    }
+
+    // Reaps the simulator, killing it first if its output has not ended. Returns false when a simulator whose
+    // output ended exited nonzero or on a signal; one stopped here says nothing about its own run.
+    bool Close() {
+        if (fd >= 0) close(fd);
+        fd = -1;
+        if (pid <= 0) return true;
+        if (!eof) kill(pid, SIGKILL);
+        int status = 0;
+        bool reaped = waitpid(pid, &status, 0) == pid;
+        pid = 0;
+        if (!eof) return true;
+        if (!reaped) failure = "could not be waited for";
+        else if (WIFSIGNALED(status)) failure = "killed by signal " + std::to_string(WTERMSIG(status));
+        else if (WEXITSTATUS(status)) failure = "exited with status " + std::to_string(WEXITSTATUS(status));
+        return failure.empty();
+    }
+};
+
+struct Binary {
+    std::string path;
+    std::vector<std::string> args; // after <ROB> <IQ> <WIDTH> <trace>
+};
+
+struct Config {
+    int rob, iq, width;
+    std::string trace;
+};
+
+enum Verdict {SAME, DIVERGED, TIMED_OUT, FAILED};
+static const char *verdict_str[] = {"same", "DIVERGED", "timed out", "failed"};
+
+struct Check {
+    Config config;
+    Verdict verdict = FAILED;
+    bool run = false; // grid mode skips the rest after -x
+    uint64_t compared = 0, records = 0;
+    std::string report; // divergence details
+};
+
+static bool Spawn(const Binary &binary, const Config &config, Stream &stream) {
+    // argv is built before fork(), grid mode forks from several threads and the child must not allocate
+    std::vector<std::string> words = {binary.path, std::to_string(config.rob), std::to_string(config.iq),
+                                      std::to_string(config.width), config.trace};
+    words.insert(words.end(), binary.args.begin(), binary.args.end());
+    std::vector<char*> argv;
+    for (auto &word : words) argv.push_back(&word[0]);
+    argv.push_back(nullptr);
+
+    int pipes[2];
+    if (pipe2(pipes, O_CLOEXEC) < 0) return false;
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(pipes[1], STDOUT_FILENO);
+        int null = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        if (null >= 0) dup2(null, STDERR_FILENO); // heartbeat and memo reports
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+    close(pipes[1]);
+    if (pid < 0) {
+        close(pipes[0]);
+        return false;
+    }
+    stream.fd = pipes[0];
+    stream.pid = pid;
+    return true;
+}
+
+static std::string Describe(const Binary &binary) {
+    std::string text = binary.path;
+    for (auto &arg : binary.args) text += " " + arg;
+    return text;
+}
+
+static void Appendf(std::string &text, const char *format, ...) __attribute__((format(printf, 2, 3)));
+static void Appendf(std::string &text, const char *format, ...) {
+    char line[4096];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    text += line;
+}
+
+// Streams a against b (a reference file when reference is set) until they differ or both end
+static void Compare(const Binary &a, const Binary &b, const char *reference, const Config &config, Check &check,
+                    size_t context_lines, bool all_lines, double idle_timeout) {
+    check.config = config;
+    check.run = true;
+    Stream streams[2];
+    streams[0].name = Describe(a);
+    bool spawned = Spawn(a, config, streams[0]);
+    if (reference) {
+        streams[1].name = reference;
+        streams[1].fd = open(reference, O_RDONLY | O_CLOEXEC);
+    } else {
+        streams[1].name = Describe(b);
+        spawned = Spawn(b, config, streams[1]) && spawned;
+    }
+    if (!spawned || streams[1].fd < 0) {
+        Appendf(check.report, "cannot start %s\n", !spawned ? "simulator" : reference);
+        for (auto &stream : streams) stream.Close();
+        return;
+    }
+
+    std::deque<std::pair<uint64_t, std::string>> context; // last lines both sides agreed on
+    std::string lines[2];
+    bool have[2] = {false, false};
+    // A hung core can keep printing its own errors, so only compared lines count as progress
+    auto last_progress = std::chrono::steady_clock::now();
+    while (true) {
+        for (int side = 0; side < 2; side++) {
+            while (!have[side] && streams[side].Line(lines[side])) have[side] = Compared(lines[side], all_lines);
+        }
+        if (have[0] && have[1]) {
+            if (lines[0] != lines[1]) {
+                check.verdict = DIVERGED;
+                break;
+            }
+            check.compared++;
+            if (RetireRecord(lines[0])) check.records++;
+            last_progress = std::chrono::steady_clock::now();
+            context.emplace_back(streams[0].line_number, lines[0]);
+            if (context.size() > context_lines) context.pop_front();
+            have[0] = have[1] = false;
+            continue;
+        }
+        bool ended[2] = {!have[0] && streams[0].Finished(), !have[1] && streams[1].Finished()};
+        if (ended[0] && ended[1]) {
+            check.verdict = SAME;
+            break;
+        }
+        if ((ended[0] && have[1]) || (ended[1] && have[0])) {
+            check.verdict = DIVERGED; // one side has a line the other never printed
+            break;
+        }
+
+        // More input from both sides, except one that is already far ahead
+        pollfd fds[2];
+        int count = 0, sides[2];
+        for (int side = 0; side < 2; side++) {
+            if (streams[side].eof || streams[side].Full()) continue;
+            fds[count] = {streams[side].fd, POLLIN, 0};
+            sides[count++] = side;
+        }
+        int ready = count ? poll(fds, count, 1000) : 0;
+        if (ready < 0 && errno != EINTR) break;
+        for (int i = 0; i < count; i++) {
+            if (fds[i].revents) streams[sides[i]].Read();
+        }
+        if (idle_timeout > 0
+            && std::chrono::duration<double>(std::chrono::steady_clock::now() - last_progress).count() >= idle_timeout) {
+            check.verdict = TIMED_OUT;
+            break;
+        }
+    }
+
+    // A simulator that crashed or exited with an error fails the check, even where its output matched
+    for (auto &stream : streams) {
+        if (!stream.Close()) check.verdict = FAILED;
+    }
+
+    if (check.verdict == FAILED) {
+        Appendf(check.report, "config: ROB %d, IQ %d, WIDTH %d, trace %s\n", config.rob, config.iq, config.width,
+            config.trace.c_str());
+        for (auto &stream : streams) {
+            if (!stream.failure.empty()) Appendf(check.report, "%s %s\n", stream.name.c_str(), stream.failure.c_str());
+        }
+    } else if (check.verdict == DIVERGED) {
+        Appendf(check.report, "config: ROB %d, IQ %d, WIDTH %d, trace %s\n", config.rob, config.iq, config.width,
+            config.trace.c_str());
+        Appendf(check.report, "first divergence after %llu matching lines (%llu records)\n",
+            (unsigned long long)check.compared, (unsigned long long)check.records);
+        for (auto &line : context) Appendf(check.report, "    %8llu  %s\n", (unsigned long long)line.first, line.second.c_str());
+        for (int side = 0; side < 2; side++) {
+            if (have[side]) {
+                Appendf(check.report, "%c %8llu  %s\n", side ? '>' : '<', (unsigned long long)streams[side].line_number,
+                    lines[side].c_str());
+            } else {
+                Appendf(check.report, "%c           (end of output)\n", side ? '>' : '<');
+            }
+        }
+        long long fields[2][NUM_FIELDS];
+        if (have[0] && have[1] && ParseRecord(lines[0], fields[0]) && ParseRecord(lines[1], fields[1])) {
+            for (int field = 0; field < NUM_FIELDS; field++) {
+                if (fields[0][field] == fields[1][field]) continue;
+                Appendf(check.report, "  %s: %lld vs %lld\n", field_str[field], fields[0][field], fields[1][field]);
+            }
+        }
+        Appendf(check.report, "< %s\n> %s\n", streams[0].name.c_str(), streams[1].name.c_str());
+    } else if (check.verdict == TIMED_OUT) {
+        Appendf(check.report, "config: ROB %d, IQ %d, WIDTH %d, trace %s\n"
+            "no timing output for %.0f s after %llu matching lines, both sides agreed up to there\n", config.rob, config.iq,
+            config.width, config.trace.c_str(), idle_timeout, (unsigned long long)check.compared);
+    }
+}
+
+static std::vector<int> ParseList(const char *text) {
+    std::vector<int> values;
+    for (const char *p = text; *p;) {
+        int v = atoi(p);
+        if (v <= 0) return {};
+        values.push_back(v);
+        p = strchr(p, ',');
+        if (!p) break;
+        p++;
+    }
+    return values;
+}
+
+static std::vector<std::string> SplitArgs(const char *text) {
+    std::vector<std::string> args;
+    for (const char *p = text; *p;) {
+        p += strspn(p, " ");
+        size_t length = strcspn(p, " ");
+        if (length) args.emplace_back(p, length);
+        p += length;
+    }
+    return args;
+}
+
+// Every regular file in proj3-traces/, sorted
+static std::vector<std::string> DefaultTraces() {
+    std::vector<std::string> traces;
+    if (DIR *dir = opendir("proj3-traces")) {
+        while (auto entry = readdir(dir)) {
+            if (entry->d_name[0] != '.') traces.push_back(std::string("proj3-traces/") + entry->d_name);
+        }
+        closedir(dir);
+    }
+    std::sort(traces.begin(), traces.end());
+    return traces;
+}
+
+static void Usage() {
+    fprintf(stderr,
+        "Usage: simdiff [options] <sim_a> <sim_b> <ROB_SIZE> <IQ_SIZE> <WIDTH> <tracefile>\n"
+        "       simdiff [options] -r <reference> <sim> <ROB_SIZE> <IQ_SIZE> <WIDTH> <tracefile>\n"
+        "       simdiff [options] -g [-R robs] [-Q iqs] [-W widths] [-j threads] [-x] <sim_a> <sim_b> [traces...]\n"
+        "  -A args / -B args   extra sim options for the first / second binary, e.g. -B --memoize\n"
+        "  -c lines            context lines before a divergence (default 5)\n"
+        "  -l                  compare every output line, not just retire records and results\n"
+        "  -t seconds          give up when no timing line arrives for this long (default 60, 0 waits forever)\n"
+        "  grid mode defaults to ROB 16,64,256, IQ 8,32, WIDTH 1,2,4,8 over proj3-traces/*; -x stops at the first\n"
+        "  divergence\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[]) {
+    Binary a, b;
+    const char *reference = nullptr;
+    bool grid = false, all_lines = false, stop_early = false;
+    size_t context_lines = 5;
+    double idle_timeout = 60;
+    std::vector<int> robs = ParseList("16,64,256"), iqs = ParseList("8,32"), widths = ParseList("1,2,4,8");
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    int opt;
+    while ((opt = getopt(argc, argv, "A:B:r:c:lt:gR:Q:W:j:x")) != -1) {
+        switch (opt) {
+            case 'A': a.args = SplitArgs(optarg); break;
+            case 'B': b.args = SplitArgs(optarg); break;
+            case 'r': reference = optarg; break;
+            case 'c': context_lines = atoi(optarg); break;
+            case 'l': all_lines = true; break;
+            case 't': idle_timeout = atof(optarg); break;
+            case 'g': grid = true; break;
+            case 'R': robs = ParseList(optarg); break;
+            case 'Q': iqs = ParseList(optarg); break;
+            case 'W': widths = ParseList(optarg); break;
+            case 'j': threads = std::max(1, atoi(optarg)); break;
+            case 'x': stop_early = true; break;
+            default: Usage();
+        }
+    }
+    signal(SIGPIPE, SIG_IGN);
+    int positional = argc - optind;
+
+    if (!grid) {
+        int binaries = reference ? 1 : 2;
+        if (positional != binaries + 4) Usage();
+        a.path = argv[optind];
+        if (!reference) b.path = argv[optind + 1];
+        char **numbers = argv + optind + binaries;
+        Config config{atoi(numbers[0]), atoi(numbers[1]), atoi(numbers[2]), numbers[3]};
+        if (config.rob <= 0 || config.iq <= 0 || config.width <= 0) Usage();
+
+        Check check;
+        Compare(a, b, reference, config, check, context_lines, all_lines, idle_timeout);
+        if (check.verdict == SAME) {
+            printf("same: %llu records, %llu lines compared\n", (unsigned long long)check.records,
+                (unsigned long long)check.compared);
+        } else {
+            printf("%s\n%s", verdict_str[check.verdict], check.report.c_str());
+        }
+        return check.verdict == SAME ? 0 : check.verdict == DIVERGED ? 1 : 2;
+    }
+
+    if (reference || positional < 2 || robs.empty() || iqs.empty() || widths.empty()) Usage();
+    a.path = argv[optind];
+    b.path = argv[optind + 1];
+    std::vector<std::string> traces(argv + optind + 2, argv + argc);
+    if (traces.empty()) traces = DefaultTraces();
+    if (traces.empty()) {
+        fprintf(stderr, "No traces given and none in proj3-traces/\n");
+        return 2;
+    }
+
+    std::vector<Check> checks;
+    for (auto &trace : traces) {
+        for (int width : widths) {
+            for (int rob : robs) {
+                for (int iq : iqs) {
+                    Check check;
+                    check.config = {rob, iq, width, trace};
+                    checks.push_back(check);
+                }
+            }
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<size_t> next(0);
+    std::atomic<bool> stop(false);
+    std::mutex print;
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < std::min<size_t>(threads, checks.size()); t++) {
+        workers.emplace_back([&] {
+            for (size_t i; !stop && (i = next++) < checks.size();) {
+                auto &check = checks[i];
+                Compare(a, b, nullptr, check.config, check, context_lines, all_lines, idle_timeout);
+                if (check.verdict != SAME && stop_early) stop = true;
+                std::lock_guard<std::mutex> lock(print);
+                printf("%-9s ROB %4d IQ %4d WIDTH %2d %s: %llu records\n", verdict_str[check.verdict],
+                    check.config.rob, check.config.iq, check.config.width, check.config.trace.c_str(),
+                    (unsigned long long)check.records);
+                fflush(stdout);
+            }
+        });
+    }
+    for (auto &worker : workers) worker.join();
+
+    size_t counts[4] = {};
+    size_t run = 0;
+    for (auto &check : checks) {
+        if (!check.run) continue;
+        run++;
+        counts[check.verdict]++;
+        if (check.verdict != SAME) printf("\n%s: %s", verdict_str[check.verdict], check.report.c_str());
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("\n# %zu of %zu configs checked in %.1f s: %zu same, %zu diverged, %zu timed out, %zu failed\n", run,
+        checks.size(), seconds, counts[SAME], counts[DIVERGED], counts[TIMED_OUT], counts[FAILED]);
+    return counts[DIVERGED] ? 1 : counts[TIMED_OUT] || counts[FAILED] || run < checks.size() ? 2 : 0;
+}
@@ -0,0 +1,337 @@
+// simlimit: one pass over a trace for the bounds no ROB_SIZE or IQ_SIZE can beat.
+// The ideal machine issues every instruction as soon as its sources are ready, with the 1/2/5 cycle latencies of
+// Instruction::GetLatency(). Its critical path bounds IPC for any WIDTH; fetching at most WIDTH instructions a
+// cycle on top of that gives the tighter per-WIDTH bound. Also reports the optype mix, the register reuse and
+// dependency distance distributions and how many operands are -1.
+// The trace is memory-mapped and parsed in line-aligned chunks on every core into 4-byte operations, then every
+// ideal machine and the distance statistics walk those on a thread each, so it runs at close to the speed the
+// file can be read.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define REGISTER_COUNT 67 // ARCHITECTURAL_REGISTER_COUNT
+#define NUM_OPTYPES 3
+#define DISTANCE_BINS 33 // power-of-two bins, the last one collects everything from 2^31 up
+#define CHUNKS_PER_THREAD 8
+#define FAST_LINE_MAX 64 // longer than any line FastLine() accepts, so it never reads past the chunk
+
+static const int latency[NUM_OPTYPES] = {1, 2, 5};
+
+// One trace line as far as the bounds are concerned, fields are already range checked
+struct Op {
+    int8_t optype, dst, src1, src2;
+};
+
+// Bin b holds distances in [2^(b-1), 2^b), bin 0 holds distance 0
+struct DistanceHistogram {
+    uint64_t bins[DISTANCE_BINS] = {};
+    uint64_t count = 0, sum = 0;
+
+    void Add(uint64_t distance) {
+        int bin = distance ? 64 - __builtin_clzll(distance) : 0;
+        bins[std::min(bin, DISTANCE_BINS - 1)]++;
+        count++;
+        sum += distance;
+    }
+
+    void Print(const char *title) const {
+        printf("\n# %s: %llu samples, mean %.2f instructions\n%12s %12s %8s %8s\n", title, (unsigned long long)count,
+            count ? static_cast<double>(sum) / count : 0.0, "distance", "count", "%", "cum %");
+        uint64_t seen = 0;
+        for (int b = 0; b < DISTANCE_BINS; b++) {
+            if (!bins[b]) continue;
+            seen += bins[b];
+            char range[48];
+            if (b <= 1) snprintf(range, sizeof(range), "%d", b);
+            else if (b == DISTANCE_BINS - 1) snprintf(range, sizeof(range), "%llu+", 1ull << (b - 1));
+            else snprintf(range, sizeof(range), "%llu-%llu", 1ull << (b - 1), (1ull << b) - 1);
+            printf("%12s %12llu %8.2f %8.2f\n", range, (unsigned long long)bins[b],
+                100.0 * bins[b] / count, 100.0 * seen / count);
+        }
+    }
+};
+
+// Ideal machine that fetches at most width instructions per cycle, width 0 is unlimited
+struct Dataflow {
+    unsigned width;
+    uint64_t finish = 0; // latest completion, the critical path
+
+    explicit Dataflow(unsigned width) : width(width) {}
+
+    void Run(const std::vector<Op> &ops) {
+        uint64_t ready[REGISTER_COUNT] = {}; // cycle each register's latest value is available
+        for (size_t i = 0; i < ops.size(); i++) {
+            auto &op = ops[i];
+            uint64_t start = width ? i / width : 0;
+            if (op.src1 >= 0) start = std::max(start, ready[op.src1]);
+            if (op.src2 >= 0) start = std::max(start, ready[op.src2]);
+            uint64_t done = start + latency[op.optype];
+            if (op.dst >= 0) ready[op.dst] = done;
+            finish = std::max(finish, done);
+        }
+    }
+};
+
+// Everything but the critical paths
+struct Characterization {
+    uint64_t optypes[NUM_OPTYPES] = {};
+    uint64_t missing_src = 0, missing_dst = 0; // -1 operands
+    DistanceHistogram dependency, reuse;
+
+    void Run(const std::vector<Op> &ops) {
+        int64_t last_write[REGISTER_COUNT], last_use[REGISTER_COUNT];
+        std::fill(last_write, last_write + REGISTER_COUNT, -1);
+        std::fill(last_use, last_use + REGISTER_COUNT, -1);
+        for (size_t i = 0; i < ops.size(); i++) {
+            auto &op = ops[i];
+            auto index = static_cast<int64_t>(i);
+            optypes[op.optype]++;
+            for (int src : {op.src1, op.src2}) {
+                if (src < 0) {
+                    missing_src++;
+                    continue;
+                }
+                if (last_write[src] >= 0) dependency.Add(index - last_write[src]);
+                if (last_use[src] >= 0) reuse.Add(index - last_use[src]);
+                last_use[src] = index;
+            }
+            if (op.dst < 0) {
+                missing_dst++;
+            } else {
+                if (last_use[op.dst] >= 0) reuse.Add(index - last_use[op.dst]);
+                last_use[op.dst] = last_write[op.dst] = index;
+            }
+        }
+    }
+};
+
+static const char *SkipSpace(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    return p;
+}
+
+static const char *ParseHex(const char *p, const char *end, bool &ok) {
+    const char *start = p;
+    while (p < end && ((*p >= '0' && *p <= '9') || (*p >= 'a' && *p <= 'f') || (*p >= 'A' && *p <= 'F'))) p++;
+    ok = ok && p > start;
+    return p;
+}
+
+static const char *ParseInt(const char *p, const char *end, int &value, bool &ok) {
+    bool negative = p < end && *p == '-';
+    if (negative) p++;
+    const char *start = p;
+    value = 0;
+    while (p < end && *p >= '0' && *p <= '9' && p - start < 9) value = value * 10 + (*p++ - '0');
+    ok = ok && p > start;
+    if (negative) value = -value;
+    return p;
+}
+
+// "-?[0-9]{1,2}" then one space or the end of the line, returns nullptr on anything else
+static inline const char *FastField(const char *p, int &value, char terminator) {
+    bool negative = *p == '-';
+    p += negative;
+    if (*p < '0' || *p > '9') return nullptr;
+    value = *p++ - '0';
+    if (*p >= '0' && *p <= '9') value = value * 10 + (*p++ - '0');
+    if (negative) value = -value;
+    if (terminator == '\n' && *p == '\r') p++;
+    return *p == terminator ? p + 1 : nullptr;
+}
+
+// The common case of a well-formed line with single spaces, returns the next line or nullptr to fall back
+static inline const char *FastLine(const char *p, Op &op) {
+    static const struct HexTable {
+        bool digit[256] = {};
+        HexTable() {for (const char *c = "0123456789abcdefABCDEF"; *c; c++) digit[static_cast<unsigned char>(*c)] = true;}
+    } hex;
+    const char *start = p;
+    while (hex.digit[static_cast<unsigned char>(*p)] && p - start < 16) p++;
+    if (p == start || *p++ != ' ') return nullptr;
+    int optype, dst, src1, src2;
+    if (!(p = FastField(p, optype, ' ')) || !(p = FastField(p, dst, ' '))
+        || !(p = FastField(p, src1, ' ')) || !(p = FastField(p, src2, '\n'))) return nullptr;
+    if (optype < 0 || optype >= NUM_OPTYPES || dst < -1 || dst >= REGISTER_COUNT
+        || src1 < -1 || src1 >= REGISTER_COUNT || src2 < -1 || src2 >= REGISTER_COUNT) return nullptr;
+    op = {static_cast<int8_t>(optype), static_cast<int8_t>(dst), static_cast<int8_t>(src1), static_cast<int8_t>(src2)};
+    return p;
+}
+
+// "<pc> <optype> <dst> <src1> <src2>" per line, the pc is only checked for shape. Returns the malformed line count.
+static uint64_t ParseChunk(const char *begin, const char *end, std::vector<Op> &ops) {
+    uint64_t malformed = 0;
+    for (const char *line = begin; line < end;) {
+        Op op;
+        const char *next;
+        if (end - line >= FAST_LINE_MAX && (next = FastLine(line, op))) {
+            ops.push_back(op);
+            line = next;
+            continue;
+        }
+        auto newline = static_cast<const char*>(memchr(line, '\n', end - line));
+        const char *line_end = newline ? newline : end;
+        const char *p = SkipSpace(line, line_end);
+        if (p < line_end) {
+            bool ok = true;
+            int optype, dst, src1, src2;
+            p = ParseHex(p, line_end, ok);
+            p = ParseInt(SkipSpace(p, line_end), line_end, optype, ok);
+            p = ParseInt(SkipSpace(p, line_end), line_end, dst, ok);
+            p = ParseInt(SkipSpace(p, line_end), line_end, src1, ok);
+            p = ParseInt(SkipSpace(p, line_end), line_end, src2, ok);
+            ok = ok && optype >= 0 && optype < NUM_OPTYPES
+                && dst >= -1 && dst < REGISTER_COUNT && src1 >= -1 && src1 < REGISTER_COUNT
+                && src2 >= -1 && src2 < REGISTER_COUNT;
+            if (ok) {
+                ops.push_back({static_cast<int8_t>(optype), static_cast<int8_t>(dst),
+                    static_cast<int8_t>(src1), static_cast<int8_t>(src2)});
+            } else {
+                malformed++;
+            }
+        }
+        line = line_end + 1;
+    }
+    return malformed;
+}
+
+static void Usage() {
+    fprintf(stderr, "Usage: simlimit [-j threads] [-w widths] [-o bounds.csv] <tracefile>\n");
+    exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned> widths = {1, 2, 4, 8, 16};
+    const char *csv_path = nullptr;
+    int opt;
+    while ((opt = getopt(argc, argv, "j:w:o:")) != -1) {
+        switch (opt) {
+            case 'j': threads = std::max(1, atoi(optarg)); break;
+            case 'w': {
+                widths.clear();
+                for (const char *p = optarg; p; p = strchr(p, ',') ? strchr(p, ',') + 1 : nullptr) {
+                    int width = atoi(p);
+                    if (width <= 0) Usage();
+                    widths.push_back(width);
+                }
+                break;
+            }
+            case 'o': csv_path = optarg; break;
+            default: Usage();
+        }
+    }
+    if (optind != argc - 1 || widths.empty()) Usage();
+
+    int fd = open(argv[optind], O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "Cannot open trace `%s', exiting...\n", argv[optind]);
+        exit(-1);
+    }
+    size_t length = st.st_size;
+    const char *data = nullptr;
+    if (length) {
+        data = static_cast<const char*>(mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0));
+        if (data == MAP_FAILED) {
+            fprintf(stderr, "Cannot map trace `%s', exiting...\n", argv[optind]);
+            exit(-1);
+        }
+        madvise(const_cast<char*>(data), length, MADV_SEQUENTIAL);
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    // chunk boundaries are moved forward to the next line start
+    size_t chunk_count = std::max<size_t>(1, std::min<size_t>(threads * CHUNKS_PER_THREAD, length / 4096 + 1));
+    std::vector<size_t> bounds{0};
+    for (size_t i = 1; i < chunk_count; i++) {
+        size_t at = std::max(bounds.back(), length / chunk_count * i);
+        auto newline = static_cast<const char*>(memchr(data + at, '\n', length - at));
+        at = newline ? newline - data + 1 : length;
+        if (at > bounds.back()) bounds.push_back(at);
+    }
+    bounds.push_back(length);
+
+    std::vector<std::vector<Op>> chunks(bounds.size() - 1);
+    std::vector<uint64_t> chunk_malformed(chunks.size());
+    std::atomic<size_t> next_chunk(0);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            for (size_t c; (c = next_chunk++) < chunks.size();) {
+                chunks[c].reserve((bounds[c + 1] - bounds[c]) / 16);
+                chunk_malformed[c] = ParseChunk(data + bounds[c], data + bounds[c + 1], chunks[c]);
+            }
+        });
+    }
+    for (auto &worker : workers) worker.join();
+    workers.clear();
+    if (length) munmap(const_cast<char*>(data), length);
+    close(fd);
+
+    std::vector<Op> ops;
+    uint64_t malformed = 0;
+    size_t total = 0;
+    for (auto &chunk : chunks) total += chunk.size();
+    ops.reserve(total);
+    for (size_t c = 0; c < chunks.size(); c++) {
+        ops.insert(ops.end(), chunks[c].begin(), chunks[c].end());
+        std::vector<Op>().swap(chunks[c]);
+        malformed += chunk_malformed[c];
+    }
+
+    // the walks are sequential by nature, but independent of each other
+    std::vector<Dataflow> machines{Dataflow(0)};
+    for (auto width : widths) machines.emplace_back(width);
+    Characterization character;
+    for (auto &machine : machines) workers.emplace_back([&] {machine.Run(ops);});
+    workers.emplace_back([&] {character.Run(ops);});
+    for (auto &worker : workers) worker.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "%.1f MB in %.3f s (%.0f MB/s)\n", length / 1e6, seconds, seconds > 0 ? length / 1e6 / seconds : 0.0);
+
+    uint64_t n = ops.size();
+    printf("# instructions %llu, malformed lines %llu\n", (unsigned long long)n, (unsigned long long)malformed);
+    if (!n) return 0;
+
+    printf("\n# optype mix\n");
+    for (int o = 0; o < NUM_OPTYPES; o++) {
+        printf("op%d (latency %d) %12llu %8.2f%%\n", o, latency[o], (unsigned long long)character.optypes[o],
+            100.0 * character.optypes[o] / n);
+    }
+    printf("\n# -1 operands\nsrc %.2f%% of %llu, dst %.2f%% of %llu\n",
+        100.0 * character.missing_src / (2 * n), (unsigned long long)(2 * n),
+        100.0 * character.missing_dst / n, (unsigned long long)n);
+
+    printf("\n# dataflow limit\ncritical path %llu cycles, IPC bound %.4f\n",
+        (unsigned long long)machines[0].finish, static_cast<double>(n) / machines[0].finish);
+
+    // No config at a WIDTH can exceed its bound, sweeps can skip any target above it
+    FILE *csv = csv_path ? fopen(csv_path, "w") : nullptr;
+    if (csv_path && !csv) fprintf(stderr, "Cannot create `%s', skipping bound output\n", csv_path);
+    if (csv) fprintf(csv, "width,min_cycles,ipc_bound\n");
+    printf("\n# IPC upper bound per WIDTH (dataflow with WIDTH-wide fetch)\n%8s %12s %10s\n", "WIDTH", "min cycles", "IPC bound");
+    for (size_t m = 1; m < machines.size(); m++) {
+        double bound = static_cast<double>(n) / machines[m].finish;
+        printf("%8u %12llu %10.4f\n", machines[m].width, (unsigned long long)machines[m].finish, bound);
+        if (csv) fprintf(csv, "%u,%llu,%.4f\n", machines[m].width, (unsigned long long)machines[m].finish, bound);
+    }
+    if (csv) fclose(csv);
+
+    character.dependency.Print("dependency distance (producer to consumer)");
+    character.reuse.Print("register reuse distance (previous reference to the same register)");
+    return 0;
+}
@@ -0,0 +1,302 @@
+// simsearch: finds the smallest ROB_SIZE x IQ_SIZE within a tolerance of peak IPC for each WIDTH
+// without simulating the whole grid.
+// At a fixed WIDTH IPC does not decrease as the ROB or IQ grows, so the configs that reach the target form a
+// staircase: every row (ROB size) binary searches for its smallest passing IQ size, and every probe result
+// narrows the search of the other rows too. A passing (rob, iq) passes for all larger ROBs at that IQ, and a
+// failing one fails for all smaller ROBs. Each round simulates the midpoint of every unfinished row, on every core.
+// A probe that stalls (hits the cycle cap) neither passes nor fails: it narrows nothing, the row probes the next
+// closest IQ size instead, and stalled probes are reported on their own.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <thread>
+#include <tuple>
+#include <unistd.h>
+#include <vector>
+
+#include "../ResultsCache.h"
+#include "../Simulator.h"
+
+#define STEP_CYCLES (1 << 16)
+#define STALL_CYCLES (1 << 20) // no retirement for this long counts as a hung simulation
+
+struct Probe {
+    int width, rob, iq;
+    SimResult result;
+    bool stalled = false;
+    bool cached = false;
+};
+
+typedef std::tuple<int,int,int> ProbeKey; // width, rob, iq
+
+static void Simulate(const TraceRecord *records, size_t count, Probe &probe) {
+    Simulator simulator(SimConfig{probe.rob, probe.iq, probe.width});
+    simulator.Feed(records, count);
+    simulator.CloseInput();
+    uint64_t last_retired = 0, last_progress = 0;
+    while (!simulator.Done()) {
+        simulator.Step(STEP_CYCLES);
+        if (simulator.GetRetiredCount() != last_retired) {
+            last_retired = simulator.GetRetiredCount();
+            last_progress = simulator.GetCycleCount();
+        } else if (simulator.GetCycleCount() - last_progress >= STALL_CYCLES) {
+            probe.stalled = true;
+            break;
+        }
+    }
+    probe.result = {simulator.GetRetiredCount(), simulator.GetCycleCount(), 0.0};
+    if (probe.result.cycles) probe.result.ipc = static_cast<double>(probe.result.instructions) / probe.result.cycles;
+}
+
+// Geometric range "lo:hi", doubling from lo
+static std::vector<int> ParseRange(const char *text) {
+    int lo = 0, hi = 0;
+    std::vector<int> values;
+    if (sscanf(text, "%d:%d", &lo, &hi) != 2 || lo <= 0 || hi < lo) return values;
+    for (int v = lo; v <= hi; v *= 2) values.push_back(v);
+    if (values.back() != hi) values.push_back(hi);
+    return values;
+}
+
+static std::vector<int> ParseList(const char *text) {
+    std::vector<int> values;
+    for (const char *p = text; *p;) {
+        int v = atoi(p);
+        if (v <= 0) return {};
+        values.push_back(v);
+        p = strchr(p, ',');
+        if (!p) break;
+        p++;
+    }
+    return values;
+}
+
+static void Usage() {
+    fprintf(stderr, "Usage: simsearch [-r rob_lo:rob_hi] [-q iq_lo:iq_hi] [-w widths] [-t tolerance%%] [-j threads]"
+        " [-o probes.csv] <tracefile>\n");
+    exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<int> robs = ParseRange("16:512"), iqs = ParseRange("8:256"), widths = ParseList("1,2,4,8");
+    double tolerance = 5;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    const char *csv_path = nullptr;
+    int opt;
+    while ((opt = getopt(argc, argv, "r:q:w:t:j:o:")) != -1) {
+        switch (opt) {
+            case 'r': robs = ParseRange(optarg); break;
+            case 'q': iqs = ParseRange(optarg); break;
+            case 'w': widths = ParseList(optarg); break;
+            case 't': tolerance = atof(optarg); break;
+            case 'j': threads = std::max(1, atoi(optarg)); break;
+            case 'o': csv_path = optarg; break;
+            default: Usage();
+        }
+    }
+    if (optind != argc - 1 || robs.empty() || iqs.empty() || widths.empty() || tolerance < 0) Usage();
+
+    TraceRecord *records = nullptr;
+    uint64_t trace_hash = 0;
+    int64_t count = Trace_Decode(argv[optind], &records, &trace_hash);
+    if (count < 0) {
+        fprintf(stderr, "Cannot read trace `%s', exiting...\n", argv[optind]);
+        exit(-1);
+    }
+
+    // Same cache as sim, opt in with SIM_CACHE_DIR
+    ResultsCache *cache = getenv("SIM_CACHE_DIR") ? new ResultsCache() : nullptr;
+
+    std::map<ProbeKey, Probe> probes;
+    // Runs every probe in keys that has no result yet, in parallel
+    auto run = [&](const std::vector<ProbeKey> &keys) {
+        std::vector<Probe*> pending;
+        for (auto &key : keys) {
+            if (probes.count(key)) continue;
+            auto &probe = probes[key];
+            std::tie(probe.width, probe.rob, probe.iq) = key;
+            if (cache && cache->Lookup({trace_hash, probe.rob, probe.iq, probe.width}, probe.result)) {
+                probe.cached = true;
+            } else {
+                pending.push_back(&probe);
+            }
+        }
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < std::min<size_t>(threads, pending.size()); t++) {
+            workers.emplace_back([&] {
+                for (size_t i; (i = next++) < pending.size();) Simulate(records, count, *pending[i]);
+            });
+        }
+        for (auto &worker : workers) worker.join();
+        for (auto probe : pending) {
+            if (cache && !probe->stalled) {
+                cache->Store({trace_hash, probe->rob, probe->iq, probe->width}, probe->result);
+            }
+        }
+    };
+
+    // Peak IPC per width is at the largest ROB and IQ
+    std::vector<ProbeKey> peaks;
+    for (int width : widths) peaks.emplace_back(width, robs.back(), iqs.back());
+    run(peaks);
+
+    // Per width and row, the smallest IQ index that might pass is lo and the smallest known to pass is hi.
+    // hi == iqs.size() means nothing in the row is known to pass yet.
+    size_t rows = robs.size(), cols = iqs.size();
+    std::vector<std::vector<size_t>> lo(widths.size(), std::vector<size_t>(rows, 0));
+    std::vector<std::vector<size_t>> hi(widths.size(), std::vector<size_t>(rows, cols));
+    // A row whose every remaining IQ size stalled cannot be narrowed further
+    std::vector<std::vector<bool>> unresolved(widths.size(), std::vector<bool>(rows, false));
+    std::vector<double> target(widths.size());
+    for (size_t w = 0; w < widths.size(); w++) {
+        auto &peak = probes[peaks[w]];
+        target[w] = peak.result.ipc * (1 - tolerance / 100);
+        hi[w][rows - 1] = cols - 1;
+        if (peak.stalled) { // no target to search for
+            for (size_t r = 0; r < rows; r++) lo[w][r] = hi[w][r] = cols;
+        }
+    }
+    auto passes = [&](size_t w, const Probe &probe) {return probe.result.ipc >= target[w];};
+    auto stalled = [&](size_t w, size_t r, size_t c) {
+        auto it = probes.find(ProbeKey(widths[w], robs[r], iqs[c]));
+        return it != probes.end() && it->second.stalled;
+    };
+    // The IQ index nearest the middle of the row's open range that has not stalled, cols if all of them have
+    auto pick = [&](size_t w, size_t r) {
+        size_t begin = lo[w][r], end = std::min(hi[w][r], cols), mid = (begin + end) / 2;
+        for (size_t d = 0; mid >= begin + d || mid + d < end; d++) {
+            if (mid >= begin + d && !stalled(w, r, mid - d)) return mid - d;
+            if (mid + d < end && !stalled(w, r, mid + d)) return mid + d;
+        }
+        return cols;
+    };
+
+    while (true) {
+        std::vector<ProbeKey> round;
+        for (size_t w = 0; w < widths.size(); w++) {
+            for (size_t r = 0; r < rows; r++) {
+                if (lo[w][r] < hi[w][r] && lo[w][r] < cols && !unresolved[w][r]) {
+                    size_t c = pick(w, r);
+                    if (c == cols) {
+                        unresolved[w][r] = true;
+                    } else {
+                        round.emplace_back(widths[w], robs[r], iqs[c]);
+                    }
+                }
+            }
+        }
+        if (round.empty()) break;
+        run(round);
+
+        // monotonicity carries every result to the rows above (pass) or below (fail), stalls carry nothing
+        for (size_t w = 0; w < widths.size(); w++) {
+            for (size_t r = 0; r < rows; r++) {
+                for (size_t c = 0; c < cols; c++) {
+                    auto it = probes.find(ProbeKey(widths[w], robs[r], iqs[c]));
+                    if (it == probes.end() || it->second.stalled) continue;
+                    if (passes(w, it->second)) {
+                        for (size_t above = r; above < rows; above++) hi[w][above] = std::min(hi[w][above], c);
+                    } else {
+                        for (size_t below = 0; below <= r; below++) lo[w][below] = std::max(lo[w][below], c + 1);
+                    }
+                }
+            }
+        }
+    }
+
+    FILE *csv = csv_path ? fopen(csv_path, "w") : nullptr;
+    if (csv_path && !csv) fprintf(stderr, "Cannot create `%s', skipping probe output\n", csv_path);
+    if (csv) fprintf(csv, "width,rob_size,iq_size,instructions,cycles,ipc,stalled,cached\n");
+
+    for (size_t w = 0; w < widths.size(); w++) {
+        int width = widths[w];
+        auto &peak = probes[peaks[w]];
+        if (peak.stalled) {
+            printf("# WIDTH %d: peak at ROB %d IQ %d stalled, nothing to search for\n", width, robs.back(), iqs.back());
+        } else {
+            printf("# WIDTH %d: peak IPC %.4f at ROB %d IQ %d, target %.4f (%.1f%% of peak)\n", width,
+                peak.result.ipc, robs.back(), iqs.back(), target[w], 100 - tolerance);
+
+            // staircase of the smallest passing IQ per ROB, rows with a smaller IQ than the row below are the minimal
+            // ones. An unresolved row's answer lies among IQ sizes that stalled, it is listed with its open range.
+            printf("# smallest configs within tolerance\n%8s %8s %8s\n", "ROB", "IQ", "IPC");
+            size_t best_iq = cols;
+            for (size_t r = 0; r < rows; r++) {
+                if (unresolved[w][r]) {
+                    printf("%8d %8s %8s unresolved, IQ %d..%d stalled\n", robs[r], "?", "-", iqs[lo[w][r]],
+                        iqs[std::min(hi[w][r], cols) - 1]);
+                    continue;
+                }
+                if (hi[w][r] >= cols || hi[w][r] >= best_iq) continue;
+                best_iq = hi[w][r];
+                auto &probe = probes[ProbeKey(width, robs[r], iqs[best_iq])];
+                printf("%8d %8d %8.4f\n", robs[r], iqs[best_iq], probe.result.ipc);
+            }
+        }
+
+        // Pareto frontier of ROB + IQ entries against IPC, over everything simulated at this width
+        std::vector<const Probe*> simulated_here, stalled_here;
+        for (auto &entry : probes) {
+            if (entry.second.width != width) continue;
+            (entry.second.stalled ? stalled_here : simulated_here).push_back(&entry.second);
+        }
+        std::sort(simulated_here.begin(), simulated_here.end(), [](const Probe *a, const Probe *b) {
+            int size_a = a->rob + a->iq, size_b = b->rob + b->iq;
+            return size_a != size_b ? size_a < size_b : a->result.ipc > b->result.ipc;
+        });
+        printf("# Pareto frontier, entries (ROB + IQ) against IPC\n%8s %8s %8s %8s\n", "entries", "ROB", "IQ", "IPC");
+        double best_ipc = -1;
+        for (auto probe : simulated_here) {
+            bool frontier = probe->result.ipc > best_ipc;
+            if (frontier) {
+                best_ipc = probe->result.ipc;
+                printf("%8d %8d %8d %8.4f\n", probe->rob + probe->iq, probe->rob, probe->iq, probe->result.ipc);
+            }
+            if (csv) fprintf(csv, "%d,%d,%d,%llu,%llu,%.4f,%d,%d\n", width, probe->rob, probe->iq,
+                (unsigned long long)probe->result.instructions, (unsigned long long)probe->result.cycles,
+                probe->result.ipc, probe->stalled, probe->cached);
+        }
+        if (!stalled_here.empty()) {
+            printf("# stalled probes, no retirement for %d cycles, left out of the search\n%8s %8s %12s\n",
+                STALL_CYCLES, "ROB", "IQ", "cycles");
+            for (auto probe : stalled_here) {
+                printf("%8d %8d %12llu\n", probe->rob, probe->iq, (unsigned long long)probe->result.cycles);
+                if (csv) fprintf(csv, "%d,%d,%d,%llu,%llu,%.4f,%d,%d\n", width, probe->rob, probe->iq,
+                    (unsigned long long)probe->result.instructions, (unsigned long long)probe->result.cycles,
+                    probe->result.ipc, probe->stalled, probe->cached);
+            }
+        }
+        printf("\n");
+    }
+    if (csv) fclose(csv);
+
+    // A width whose peak stalled was abandoned, not searched, so its unprobed points were never saved by the search
+    size_t searched = 0, evaluated = 0, from_cache = 0;
+    for (size_t w = 0; w < widths.size(); w++) {
+        if (probes[peaks[w]].stalled) continue;
+        searched++;
+        for (auto &entry : probes) {
+            if (entry.second.width != widths[w]) continue;
+            evaluated++;
+            if (entry.second.cached) from_cache++;
+        }
+    }
+    size_t grid = rows * cols * searched;
+    printf("# %zu of %zu grid points evaluated (%zu simulated, %zu from cache), %zu simulations saved (%.1f%%)\n",
+        evaluated, grid, evaluated - from_cache, from_cache, grid - evaluated,
+        grid ? 100.0 * (grid - evaluated) / grid : 0.0);
+    if (searched < widths.size()) {
+        printf("# %zu of %zu widths abandoned after their peak stalled, left out of the count above\n",
+            widths.size() - searched, widths.size());
+    }
+
+    delete cache;
+    delete[] records;
+    return 0;
+}
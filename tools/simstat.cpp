@@ -0,0 +1,248 @@
+// simstat: summarizes the per-instruction timing lines sim prints at retire.
+// The log is memory-mapped and split into line-aligned chunks that are parsed on every core, then merged.
+// A retire record is a timing line with a nonzero RT field. sim also prints every instruction when it leaves
+// register read, with RT{0,0} since it has not retired yet; those lines are skipped like any other non-record.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define NUM_STAGES 9
+#define NUM_OPTYPES 3
+#define HISTOGRAM_BINS (1 << 16)
+#define CHUNKS_PER_THREAD 8
+
+static const char *stage_str[NUM_STAGES] = {"FE", "DE", "RN", "RR", "DI", "IS", "EX", "WB", "RT"};
+
+// Exact counts below HISTOGRAM_BINS cycles, larger values share the last bin but keep the true max
+struct Histogram {
+    std::vector<uint64_t> bins;
+    uint64_t count = 0, sum = 0, max = 0;
+
+    Histogram() : bins(HISTOGRAM_BINS) {}
+
+    void Add(uint64_t value) {
+        bins[std::min<uint64_t>(value, HISTOGRAM_BINS - 1)]++;
+        count++;
+        sum += value;
+        max = std::max(max, value);
+    }
+
+    void Merge(const Histogram &other) {
+        for (size_t i = 0; i < bins.size(); i++) bins[i] += other.bins[i];
+        count += other.count;
+        sum += other.sum;
+        max = std::max(max, other.max);
+    }
+
+    uint64_t Percentile(double p) const {
+        if (!count) return 0;
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(p / 100.0 * count + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < bins.size(); i++) {
+            seen += bins[i];
+            if (seen >= rank) return i == bins.size() - 1 ? max : i;
+        }
+        return max;
+    }
+
+    void Print(const char *name, FILE *out = stdout) const {
+        fprintf(out, "%-10s %12llu %9.2f %6llu %6llu %6llu %6llu %8llu\n", name, (unsigned long long)count,
+            count ? static_cast<double>(sum) / count : 0.0,
+            (unsigned long long)Percentile(50), (unsigned long long)Percentile(90),
+            (unsigned long long)Percentile(99), (unsigned long long)Percentile(99.9), (unsigned long long)max);
+    }
+};
+
+struct Stats {
+    uint64_t lines = 0, skipped = 0;
+    uint64_t first_cycle = UINT64_MAX, last_cycle = 0;
+    Histogram stage[NUM_STAGES];
+    Histogram issue_wait[NUM_OPTYPES + 1]; // last entry collects unknown optypes
+    Histogram execute[NUM_OPTYPES + 1];
+    std::vector<uint64_t> retired; // retirements per step-sized bin of cycles
+
+    void Merge(const Stats &other) {
+        lines += other.lines;
+        skipped += other.skipped;
+        first_cycle = std::min(first_cycle, other.first_cycle);
+        last_cycle = std::max(last_cycle, other.last_cycle);
+        for (int i = 0; i < NUM_STAGES; i++) stage[i].Merge(other.stage[i]);
+        for (int i = 0; i <= NUM_OPTYPES; i++) {
+            issue_wait[i].Merge(other.issue_wait[i]);
+            execute[i].Merge(other.execute[i]);
+        }
+        if (retired.size() < other.retired.size()) retired.resize(other.retired.size());
+        for (size_t i = 0; i < other.retired.size(); i++) retired[i] += other.retired[i];
+    }
+};
+
+// "<seq> fu{<op>} src{<a>,<b>} dst{<d>} FE{<begin>,<length>} ... RT{<begin>,<length>}"
+#define FIELDS_PER_LINE (1 + 1 + 2 + 1 + 2 * NUM_STAGES)
+
+// Reads every integer on the line, returns how many were found
+static int ParseLine(const char *p, const char *end, int64_t *fields) {
+    int n = 0;
+    while (p < end && n < FIELDS_PER_LINE) {
+        while (p < end && !(*p >= '0' && *p <= '9') && *p != '-') p++;
+        if (p == end) break;
+        bool negative = *p == '-';
+        if (negative) p++;
+        int64_t value = 0;
+        while (p < end && *p >= '0' && *p <= '9') value = value * 10 + (*p++ - '0');
+        fields[n++] = negative ? -value : value;
+    }
+    return n;
+}
+
+static void ParseChunk(const char *begin, const char *end, uint64_t step, Stats &stats) {
+    int64_t fields[FIELDS_PER_LINE];
+    for (const char *line = begin; line < end;) {
+        auto newline = static_cast<const char*>(memchr(line, '\n', end - line));
+        const char *line_end = newline ? newline : end;
+        // only timing lines start with the sequence number, skip summaries and ERROR output
+        if (line < line_end && *line >= '0' && *line <= '9'
+            && ParseLine(line, line_end, fields) == FIELDS_PER_LINE
+            && (fields[FIELDS_PER_LINE - 2] || fields[FIELDS_PER_LINE - 1])) {
+            stats.lines++;
+            const int64_t *timing = fields + 5;
+            for (int s = 0; s < NUM_STAGES; s++) {
+                stats.stage[s].Add(static_cast<uint64_t>(timing[2 * s + 1]));
+            }
+            int optype = fields[1] >= 0 && fields[1] < NUM_OPTYPES ? static_cast<int>(fields[1]) : NUM_OPTYPES;
+            stats.issue_wait[optype].Add(static_cast<uint64_t>(timing[2 * 5 + 1]));
+            stats.execute[optype].Add(static_cast<uint64_t>(timing[2 * 6 + 1]));
+
+            uint64_t retire_cycle = static_cast<uint64_t>(timing[2 * 8] + timing[2 * 8 + 1]);
+            stats.first_cycle = std::min(stats.first_cycle, static_cast<uint64_t>(timing[0]));
+            stats.last_cycle = std::max(stats.last_cycle, retire_cycle);
+            uint64_t bin = retire_cycle / step;
+            if (bin >= stats.retired.size()) stats.retired.resize(bin + 1 + stats.retired.size() / 2);
+            stats.retired[bin]++;
+        } else if (line < line_end) {
+            stats.skipped++;
+        }
+        line = line_end + 1;
+    }
+}
+
+static void Usage() {
+    fprintf(stderr, "Usage: simstat [-j threads] [-w window_cycles] [-s step_cycles] [-o ipc.csv] <timing-log>\n");
+    exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t window = 10000, step = 1000;
+    const char *csv_path = nullptr;
+    int opt;
+    while ((opt = getopt(argc, argv, "j:w:s:o:")) != -1) {
+        switch (opt) {
+            case 'j': threads = std::max(1, atoi(optarg)); break;
+            case 'w': window = strtoull(optarg, nullptr, 10); break;
+            case 's': step = strtoull(optarg, nullptr, 10); break;
+            case 'o': csv_path = optarg; break;
+            default: Usage();
+        }
+    }
+    if (optind != argc - 1 || !step || window < step) Usage();
+    window = window / step * step; // whole number of bins
+
+    int fd = open(argv[optind], O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "Cannot open timing log `%s', exiting...\n", argv[optind]);
+        exit(-1);
+    }
+    size_t length = st.st_size;
+    const char *data = nullptr;
+    if (length) {
+        data = static_cast<const char*>(mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0));
+        if (data == MAP_FAILED) {
+            fprintf(stderr, "Cannot map timing log `%s', exiting...\n", argv[optind]);
+            exit(-1);
+        }
+        madvise(const_cast<char*>(data), length, MADV_SEQUENTIAL);
+    }
+
+    // chunk boundaries are moved forward to the next line start
+    size_t chunk_count = std::max<size_t>(1, std::min<size_t>(threads * CHUNKS_PER_THREAD, length / 4096 + 1));
+    std::vector<size_t> bounds{0};
+    for (size_t i = 1; i < chunk_count; i++) {
+        size_t at = std::max(bounds.back(), length / chunk_count * i);
+        auto newline = static_cast<const char*>(memchr(data + at, '\n', length - at));
+        at = newline ? newline - data + 1 : length;
+        if (at > bounds.back()) bounds.push_back(at);
+    }
+    bounds.push_back(length);
+
+    std::vector<Stats> stats(threads);
+    std::atomic<size_t> next_chunk(0);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            for (size_t c; (c = next_chunk++) + 1 < bounds.size();) {
+                ParseChunk(data + bounds[c], data + bounds[c + 1], step, stats[t]);
+            }
+        });
+    }
+    for (auto &worker : workers) worker.join();
+    for (unsigned t = 1; t < threads; t++) stats[0].Merge(stats[t]);
+    auto &total = stats[0];
+    if (length) munmap(const_cast<char*>(data), length);
+    close(fd);
+
+    printf("# instructions %llu, skipped lines %llu\n", (unsigned long long)total.lines, (unsigned long long)total.skipped);
+    if (!total.lines) return 0;
+    uint64_t cycles = total.last_cycle - total.first_cycle;
+    printf("# cycles %llu, IPC %.4f\n", (unsigned long long)cycles, cycles ? static_cast<double>(total.lines) / cycles : 0.0);
+
+    printf("\n# stage latency (cycles)\n%-10s %12s %9s %6s %6s %6s %6s %8s\n",
+        "stage", "count", "mean", "p50", "p90", "p99", "p99.9", "max");
+    for (int s = 0; s < NUM_STAGES; s++) total.stage[s].Print(stage_str[s]);
+
+    const char *optype_str[NUM_OPTYPES + 1] = {"op0", "op1", "op2", "op?"};
+    printf("\n# issue wait (IS) by optype\n");
+    for (int o = 0; o <= NUM_OPTYPES; o++) if (total.issue_wait[o].count) total.issue_wait[o].Print(optype_str[o]);
+    printf("\n# execute (EX) by optype\n");
+    for (int o = 0; o <= NUM_OPTYPES; o++) if (total.execute[o].count) total.execute[o].Print(optype_str[o]);
+
+    // sliding window over the step-sized bins
+    uint64_t bins_per_window = window / step;
+    auto &retired = total.retired;
+    FILE *csv = csv_path ? fopen(csv_path, "w") : nullptr;
+    if (csv_path && !csv) fprintf(stderr, "Cannot create `%s', skipping window output\n", csv_path);
+    if (csv) fprintf(csv, "window_start,window_end,retired,ipc\n");
+    std::vector<double> ipcs;
+    uint64_t in_window = 0;
+    for (size_t b = 0; b < retired.size(); b++) {
+        in_window += retired[b];
+        if (b >= bins_per_window) in_window -= retired[b - bins_per_window];
+        if (b + 1 < bins_per_window) continue;
+        uint64_t start = (b + 1 - bins_per_window) * step;
+        if (start + window > total.last_cycle + 1) break; // only whole windows
+        if (start + window <= total.first_cycle) continue;
+        double ipc = static_cast<double>(in_window) / window;
+        ipcs.push_back(ipc);
+        if (csv) fprintf(csv, "%llu,%llu,%llu,%.4f\n", (unsigned long long)start,
+            (unsigned long long)(start + window), (unsigned long long)in_window, ipc);
+    }
+    if (csv) fclose(csv);
+    if (!ipcs.empty()) {
+        std::sort(ipcs.begin(), ipcs.end());
+        printf("\n# IPC over %llu-cycle windows, step %llu (%zu windows)\n", (unsigned long long)window,
+            (unsigned long long)step, ipcs.size());
+        printf("min %.4f p10 %.4f p50 %.4f p90 %.4f max %.4f\n", ipcs.front(),
+            ipcs[ipcs.size() / 10], ipcs[ipcs.size() / 2], ipcs[ipcs.size() * 9 / 10], ipcs.back());
+    }
+    return 0;
+}